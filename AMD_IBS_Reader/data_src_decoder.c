@@ -1,3 +1,5 @@
+#include "data_src_decoder.h"
+
 #include <linux/perf_event.h>
 #include <stdint.h>
 #include <stdio.h>
@@ -247,4 +249,66 @@ void get_data_src_decode_str(uint64_t v, char *out, size_t out_sz) {
 
     /* BLK */
     n += snprintf(out + n, out_sz - n, "BLK N/A");
-}
\ No newline at end of file
+}
+/* Memory source classes used for NUMA / tier attribution.
+   The composite LVLNUM + REMOTE fields are preferred when the kernel fills them
+   (AMD IBS does since v6.1), otherwise fall back to the legacy LVL bits. */
+int classify_mem_src(uint64_t v) {
+    uint64_t lvl    = (v >> PERF_MEM_LVL_SHIFT)    & 0x3FFFULL;
+    uint64_t lvlnum = (v >> PERF_MEM_LVLNUM_SHIFT) & 0xFULL;
+    uint64_t remote = (v >> PERF_MEM_REMOTE_SHIFT) & 0x1ULL;
+
+    if (lvlnum != 0 && lvlnum != PERF_MEM_LVLNUM_NA) {
+        switch (lvlnum) {
+        case PERF_MEM_LVLNUM_L1:
+        case PERF_MEM_LVLNUM_L2:
+        case PERF_MEM_LVLNUM_L3:
+        case PERF_MEM_LVLNUM_L4:
+        case PERF_MEM_LVLNUM_ANY_CACHE:
+        case PERF_MEM_LVLNUM_LFB:
+            return remote ? MEM_SRC_REMOTE_CACHE : MEM_SRC_LOCAL_CACHE;
+        case PERF_MEM_LVLNUM_RAM:
+        case PERF_MEM_LVLNUM_PMEM:
+            return remote ? MEM_SRC_REMOTE_DRAM : MEM_SRC_LOCAL_DRAM;
+        case PERF_MEM_LVLNUM_CXL:
+            return MEM_SRC_CXL;
+        default:
+            return MEM_SRC_OTHER;
+        }
+    }
+
+    if (lvl & PERF_MEM_LVL_NA) return MEM_SRC_NA;
+    if (lvl & (PERF_MEM_LVL_REM_RAM1 | PERF_MEM_LVL_REM_RAM2)) return MEM_SRC_REMOTE_DRAM;
+    if (lvl & (PERF_MEM_LVL_REM_CCE1 | PERF_MEM_LVL_REM_CCE2)) return MEM_SRC_REMOTE_CACHE;
+    if (lvl & PERF_MEM_LVL_LOC_RAM) return MEM_SRC_LOCAL_DRAM;
+    if (lvl & (PERF_MEM_LVL_L1 | PERF_MEM_LVL_L2 | PERF_MEM_LVL_L3 | PERF_MEM_LVL_LFB))
+        return MEM_SRC_LOCAL_CACHE;
+    if (lvl & (PERF_MEM_LVL_IO | PERF_MEM_LVL_UNC)) return MEM_SRC_OTHER;
+    return MEM_SRC_NA;
+}
+
+/* served from beyond the local L3 (DRAM, remote cache, CXL). AMD reports DRAM
+   fills as "RAM hit", so is_cache_miss(.., L3) alone misses them. */
+int is_llc_miss(uint64_t data_src) {
+    switch (classify_mem_src(data_src)) {
+    case MEM_SRC_LOCAL_DRAM:
+    case MEM_SRC_REMOTE_DRAM:
+    case MEM_SRC_REMOTE_CACHE:
+    case MEM_SRC_CXL:
+        return 1;
+    default:
+        return is_cache_miss(data_src, PERF_MEM_LVL_L3);
+    }
+}
+
+const char *mem_src_str(int cls) {
+    switch (cls) {
+    case MEM_SRC_LOCAL_CACHE:  return "LOC_CACHE";
+    case MEM_SRC_LOCAL_DRAM:   return "LOC_DRAM";
+    case MEM_SRC_REMOTE_DRAM:  return "REM_DRAM";
+    case MEM_SRC_REMOTE_CACHE: return "REM_CACHE";
+    case MEM_SRC_CXL:          return "CXL";
+    case MEM_SRC_OTHER:        return "OTHER";
+    default:                   return "N/A";
+    }
+}
@@ -9,4 +9,19 @@ int is_cache_miss(uint64_t data_src, uint64_t cache_level);
 int is_tlb_miss(uint64_t data_src);
 void decode_data_src(uint64_t data_src);
 
+enum mem_src_class {
+    MEM_SRC_NA = 0,
+    MEM_SRC_LOCAL_CACHE,
+    MEM_SRC_LOCAL_DRAM,
+    MEM_SRC_REMOTE_DRAM,
+    MEM_SRC_REMOTE_CACHE,
+    MEM_SRC_CXL,
+    MEM_SRC_OTHER,
+    MEM_SRC_NR,
+};
+
+int classify_mem_src(uint64_t data_src);
+int is_llc_miss(uint64_t data_src);
+const char *mem_src_str(int cls);
+
 #endif // DATA_SRC_DECODER_H
\ No newline at end of file
@@ -39,6 +39,31 @@ int main() {
         assert(strcmp(buf, tests[i].expected_str) == 0);
     }
 
+    /* memory source class used for NUMA / tier attribution */
+    struct {
+        uint64_t data_src;
+        int expected;
+    } src_tests[] = {
+        {0x229080142ULL, MEM_SRC_LOCAL_CACHE},    // L1 hit
+        {0x629800842ULL, MEM_SRC_LOCAL_CACHE},    // L3 hit
+        {0x1a49081042ULL, MEM_SRC_LOCAL_DRAM},    // LVLNUM RAM
+        {0x3a49081042ULL, MEM_SRC_REMOTE_DRAM},   // LVLNUM RAM + REMOTE
+        {0x2629800842ULL, MEM_SRC_REMOTE_CACHE},  // LVLNUM L3 + REMOTE
+        {0x2042ULL, MEM_SRC_REMOTE_DRAM},         // legacy LVL REM_RAM1 hit
+        {0x8042ULL, MEM_SRC_REMOTE_CACHE},        // legacy LVL REM_CCE1 hit
+        {0x1e05080021ULL, MEM_SRC_NA},
+    };
+
+    for (int i = 0; i < sizeof(src_tests) / sizeof(src_tests[0]); i++) {
+        int cls = classify_mem_src(src_tests[i].data_src);
+        printf("Src case %d: %s\n", i, mem_src_str(cls));
+        assert(cls == src_tests[i].expected);
+    }
+
+    /* DRAM fills are reported as "RAM hit" but are L3 misses */
+    assert(is_llc_miss(0x1a49081042ULL));
+    assert(!is_llc_miss(0x629800842ULL));
+
     printf("All tests passed!\n");
     return 0;
 }
@@ -2,9 +2,33 @@
  * ibs_reader.c  ——  Instruction-Based Sampling (IBS Op) reader
  *
  *   time_ns,pid,tid,cpu,ip,lin_addr,phys_addr,
- *   dc_miss,l2_miss,l3_miss,tlb_miss,data_src
+ *   data_src,data_src_decoded,mem_node,mem_src,phase,op_index,key_id,
+ *   page_size,page_flags
  *
- *   gcc -O2 -Wall -pthread ibs_reader.c -o ibs_reader
+ *   mem_node is the NUMA node owning phys_addr (-1 when unknown), mem_src is
+ *   the local/remote DRAM or cache class taken from data_src. On exit a
+ *   sampling-cpu x memory-node matrix is printed and saved to ibs_numa_matrix.csv
+ *
+ *   phase/op_index/key_id come from the workload_tag.h shared-memory slot of
+ *   the sampled tid (e.g. replay_trace), "none,0,0x0" for untagged threads.
+ *
+ *   With IBS_PAGE_FLAGS=1 every sample is resolved through /proc/<pid>/pagemap
+ *   and /proc/kpageflags: page_size is the real mapping size (4K/2M/1G) and
+ *   page_flags lists thp|hugetlb|anon|file|dirty|lru. Otherwise "0,-".
+ *
+ *   IBS_MAPS_DIR=<dir> saves /proc/kallsyms and the /proc/<pid>/maps of every
+ *   sampled pid into <dir> for Function_Address_Lookup/ip_symbolizer.
+ *
+ *   IBS_OUTPUT=stats skips the per-sample rows and only keeps the matrix.
+ *   IBS_SAMPLE_PERIOD=<ops> overrides the default period of 65535 ops, and
+ *   IBS_CLOCK=monotonic stamps time_ns with CLOCK_MONOTONIC instead of the
+ *   perf local clock (to line up with Ground_Truth_Workload windows). The clock
+ *   used ("perf" or "monotonic") is written to ibs_samples.csv.clock, so tools
+ *   joining with local_clock() stamps (reclaim_quality) can refuse the wrong one.
+ *   The ring consumer lives in ibs_ring.c, ring_bench.c stress-tests it.
+ *
+ *   gcc -O2 -Wall -pthread data_src_decoder.c numa_topology.c page_flags.c \
+ *       maps_snapshot.c ibs_ring.c ibs_reader.c -o ibs_reader
  *   sudo ./ibs_reader
  *
  *  target:
@@ -32,20 +56,9 @@
 #include <time.h>
 #include <unistd.h>
 
-#include "data_src_decoder.h"
-
-#define rmb() __sync_synchronize()
-#define wmb() __sync_synchronize()
-#define NEXT(type)               \
-    ({                           \
-        type __v = *(type *)raw; \
-        raw += sizeof(type);     \
-        __v;                     \
-    })
+#include "ibs_ring.h"
 
-#define SAMPLE_PERIOD 65535ULL
-#define RING_PAGES 8    
-#define SCRATCH_SZ 4096
+#define SAMPLE_PERIOD 65535ULL /* default, IBS_SAMPLE_PERIOD overrides */
 
 static volatile int running = 1;
 static void sigh(int sig) {
@@ -53,13 +66,6 @@ static void sigh(int sig) {
     running = 0;
 }
 
-/* monotonic ns */
-static uint64_t mono_ns(void) {
-    struct timespec ts;
-    clock_gettime(CLOCK_MONOTONIC_RAW, &ts);
-    return (uint64_t)ts.tv_sec * 1e9 + ts.tv_nsec;
-}
-
 /* Read ibs_op PMU type */
 static int get_ibs_pmu_type(void) {
     FILE *f = fopen("/sys/bus/event_source/devices/ibs_op/type", "r");
@@ -76,107 +82,6 @@ static int get_ibs_pmu_type(void) {
     return t;
 }
 
-struct cpu_ctx {
-    int cpu;
-    int fd;
-    void *ring;
-    FILE *csv;
-};
-
-static void *cpu_loop(void *arg) {
-    struct cpu_ctx *c = arg;
-    const size_t pg = sysconf(_SC_PAGESIZE);
-    const size_t ring_sz = RING_PAGES * pg;
-    const size_t mask = ring_sz - 1;
-    struct perf_event_mmap_page *meta = c->ring;
-    char *data = (char *)meta + pg;
-    char scratch[SCRATCH_SZ];
-
-    /* pin thread */
-    cpu_set_t set;
-    CPU_ZERO(&set);
-    CPU_SET(c->cpu, &set);
-    sched_setaffinity(0, sizeof(set), &set);
-
-    uint64_t last_flush = mono_ns();
-
-    while (running) {
-        uint64_t head = meta->data_head;
-        rmb();
-        while (meta->data_tail != head) {
-            uint64_t tail = meta->data_tail & mask;
-            struct perf_event_header *h = (void *)(data + tail);
-
-            /* if record cross ring tail, move to scratch */
-            if (tail + h->size > ring_sz) {
-                size_t first = ring_sz - tail;
-                if (h->size > SCRATCH_SZ) {
-                    fprintf(stderr, "record too large: %u\n", h->size);
-                    running = 0;
-                    break;
-                }
-                memcpy(scratch, data + tail, first);
-                memcpy(scratch + first, data, h->size - first);
-                h = (struct perf_event_header *)scratch;
-            }
-
-            if (h->type == PERF_RECORD_SAMPLE) {
-                char *raw = (char *)(h + 1);
-
-                /* according sample_type, parse the field */
-                uint64_t ip = NEXT(uint64_t);        /* PERF_SAMPLE_IP */
-                uint64_t pid_tid = NEXT(uint64_t);   /* PERF_SAMPLE_TID */
-                uint64_t ts = NEXT(uint64_t);        /* PERF_SAMPLE_TIME */
-                uint64_t lin_addr = NEXT(uint64_t);  /* PERF_SAMPLE_ADDR */
-                uint64_t id = NEXT(uint64_t);        /* PERF_SAMPLE_ID */
-                uint64_t cpu_res = NEXT(uint64_t);   /* PERF_SAMPLE_CPU */
-                uint64_t data_src = NEXT(uint64_t);  /* PERF_SAMPLE_DATA_SRC */
-                uint64_t phys_addr = NEXT(uint64_t); /* PERF_SAMPLE_PHYS_ADDR */
-
-                (void)id; /* unused */
-
-                uint32_t pid = pid_tid & 0xffffffff;
-                uint32_t tid = pid_tid >> 32;
-                uint32_t cpu = cpu_res & 0xffffffff;
-
-                __attribute__((unused)) int dc_miss = is_cache_miss(data_src, PERF_MEM_LVL_L1);
-                __attribute__((unused)) int l2_miss = is_cache_miss(data_src, PERF_MEM_LVL_L2);
-                __attribute__((unused)) int l3_miss = is_cache_miss(data_src, PERF_MEM_LVL_L3);
-                __attribute__((unused)) int tlb_miss = is_tlb_miss(data_src);
-
-                phys_addr &= ((1ULL << 52) - 1);
-
-                char decode_str[128];
-                get_data_src_decode_str(data_src, decode_str, sizeof(decode_str));
-
-                fprintf(c->csv,
-                        "%" PRIu64
-                        ",%u,%u,%u,0x%llx,0x%llx,0x%llx,0x%llx,%s\n",
-                        ts, pid, tid, cpu,
-                        (unsigned long long)ip,
-                        (unsigned long long)lin_addr,
-                        (unsigned long long)phys_addr,
-                        (unsigned long long)data_src,
-                        decode_str);
-
-                /* For debugging, show data_src */
-                if (getenv("DEBUG_DATASRC")) {
-                    decode_data_src(data_src);
-                }
-            }
-            meta->data_tail += h->size;
-        }
-        wmb();
-
-        if (mono_ns() - last_flush > 1e9) {
-            fflush(c->csv);
-            last_flush = mono_ns();
-        }
-        usleep(3000);
-    }
-    return NULL;
-}
-
 int main(void) {
     signal(SIGINT, sigh);
 
@@ -192,21 +97,66 @@ int main(void) {
     pthread_t *th = calloc(ncpu, sizeof(pthread_t));
     struct cpu_ctx *ctx = calloc(ncpu, sizeof(struct cpu_ctx));
 
-    FILE *csv = fopen("ibs_samples.csv", "w");
-    if (!csv) {
-        perror("fopen ibs_samples.csv");
-        return 1;
+    struct ibs_reader_cfg cfg = {.running = &running};
+    const char *out = getenv("IBS_OUTPUT");
+    if (out && !strcmp(out, "stats"))
+        cfg.output = IBS_OUTPUT_STATS;
+    cfg.debug_datasrc = getenv("DEBUG_DATASRC") != NULL;
+
+    const char *clk = getenv("IBS_CLOCK");
+    int monotonic = clk && !strcmp(clk, "monotonic");
+
+    FILE *csv = NULL;
+    if (cfg.output == IBS_OUTPUT_CSV) {
+        csv = fopen("ibs_samples.csv", "w");
+        if (!csv) {
+            perror("fopen ibs_samples.csv");
+            return 1;
+        }
+
+        fprintf(csv,
+                "time_ns,pid,tid,cpu,ip,lin_addr,phys_addr,"
+                "data_src,data_src_decoded,mem_node,mem_src,"
+                "phase,op_index,key_id,page_size,page_flags\n");
+
+        FILE *clock_f = fopen("ibs_samples.csv.clock", "w");
+        if (!clock_f) {
+            perror("fopen ibs_samples.csv.clock");
+            return 1;
+        }
+        fprintf(clock_f, "%s\n", monotonic ? "monotonic" : "perf");
+        fclose(clock_f);
     }
 
-    fprintf(csv,
-            "time_ns,pid,tid,cpu,ip,lin_addr,phys_addr,"
-            "data_src,data_src_decoded\n");
+    cfg.tags = workload_tag_attach();
+    if (!cfg.tags)
+        perror("attach workload tag table " WORKLOAD_TAG_SHM);
+
+    if (getenv("IBS_PAGE_FLAGS"))
+        cfg.page_flags_on = page_flags_init() == 0;
+
+    cfg.maps_dir = getenv("IBS_MAPS_DIR");
+    if (cfg.maps_dir && maps_snapshot_init(cfg.maps_dir) < 0)
+        cfg.maps_dir = NULL;
+
+    if (numa_topology_load(&cfg.topo, ncpu) < 0) {
+        fprintf(stderr, "NUMA topology unavailable, mem_node will be -1\n");
+        numa_topology_free(&cfg.topo);
+    }
 
     struct perf_event_attr attr = {0};
     attr.size = sizeof(attr);
     attr.type = pmu_type;
     attr.config = 0x90000; /* IBS Op event 0 */
     attr.sample_period = SAMPLE_PERIOD;
+    const char *period = getenv("IBS_SAMPLE_PERIOD");
+    if (period) {
+        attr.sample_period = strtoull(period, NULL, 0);
+        if (!attr.sample_period) {
+            fprintf(stderr, "bad IBS_SAMPLE_PERIOD %s\n", period);
+            return 1;
+        }
+    }
     attr.sample_type = PERF_SAMPLE_IP | PERF_SAMPLE_TID | PERF_SAMPLE_TIME |
                        PERF_SAMPLE_ADDR | PERF_SAMPLE_ID | PERF_SAMPLE_CPU |
                        PERF_SAMPLE_DATA_SRC | PERF_SAMPLE_PHYS_ADDR;
@@ -214,6 +164,10 @@ int main(void) {
     attr.precise_ip = 2;
     attr.sample_id_all = 1;
     attr.disabled = 1;
+    if (monotonic) {
+        attr.use_clockid = 1;
+        attr.clockid = CLOCK_MONOTONIC;
+    }
 
     for (int cpu = 0; cpu < ncpu; ++cpu) {
         int fd =
@@ -233,26 +187,47 @@ int main(void) {
         ioctl(fd, PERF_EVENT_IOC_RESET, 0);
         ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
 
-        ctx[cpu] = (struct cpu_ctx){.cpu = cpu, .fd = fd, .ring = ring, .csv = csv};
+        if (cpu_ctx_init(&ctx[cpu], &cfg, cpu, fd, ring, RING_PAGES, csv) < 0) {
+            perror("cpu_ctx_init");
+            return 1;
+        }
         pthread_create(&th[cpu], NULL, cpu_loop, &ctx[cpu]);
     }
 
     puts("IBS Op Collecting（Ctrl-C exit）…");
     puts("Setting DEBUG_DATASRC=1 can show data_src decode info. like sudo DEBUG_DATASRC=1 ./ibs_reader");
+    puts("Setting IBS_PAGE_FLAGS=1 adds THP/hugetlb/anon/file/dirty/lru info from /proc/kpageflags");
+    puts("Setting IBS_MAPS_DIR=ibs_maps keeps kallsyms and /proc/<pid>/maps for ip_symbolizer");
+    puts("Setting IBS_OUTPUT=stats skips the per-sample CSV and only keeps the NUMA matrix");
+    printf("Sample period %llu ops (IBS_SAMPLE_PERIOD), IBS_CLOCK=monotonic for CLOCK_MONOTONIC time_ns\n",
+           (unsigned long long)attr.sample_period);
 
     while (running)
         pause();
 
     /* Wait for all threads to finish */
+    uint64_t lost = 0;
     for (int cpu = 0; cpu < ncpu; ++cpu) {
         pthread_join(th[cpu], NULL);
         close(ctx[cpu].fd);
+        lost += ctx[cpu].lost;
+    }
+
+    if (csv) {
+        fflush(csv);
+        fclose(csv);
+        puts("Finish，Write info into ibs_samples.csv");
     }
+    if (lost)
+        printf("Lost %" PRIu64 " samples (ring overflow)\n", lost);
 
-    fflush(csv);
-    fclose(csv);
-    puts("Finish，Write info into ibs_samples.csv");
+    report_numa(&cfg, ctx, ncpu, "ibs_numa_matrix.csv");
 
+    for (int cpu = 0; cpu < ncpu; ++cpu)
+        cpu_ctx_free(&ctx[cpu]);
+    page_flags_exit();
+    numa_topology_free(&cfg.topo);
+    workload_tag_detach(cfg.tags);
     free(th);
     free(ctx);
     return 0;
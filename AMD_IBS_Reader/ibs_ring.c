@@ -0,0 +1,274 @@
+/*
+ * ibs_ring.c  ——  perf mmap ring consumer shared by ibs_reader and ring_bench
+ *
+ * One cpu_loop thread per ring: every poll_us it drains data_head..data_tail,
+ * copies records that wrap the ring end into a scratch buffer, turns
+ * PERF_RECORD_SAMPLE into a CSV row (or only counters in IBS_OUTPUT_STATS)
+ * and sums PERF_RECORD_LOST.
+ */
+#define _GNU_SOURCE
+#include "ibs_ring.h"
+
+#include <inttypes.h>
+#include <linux/perf_event.h>
+#include <sched.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define rmb() __sync_synchronize()
+#define wmb() __sync_synchronize()
+#define NEXT(type)               \
+    ({                           \
+        type __v = *(type *)raw; \
+        raw += sizeof(type);     \
+        __v;                     \
+    })
+
+/* monotonic ns */
+uint64_t mono_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC_RAW, &ts);
+    return (uint64_t)ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+int cpu_ctx_init(struct cpu_ctx *c, const struct ibs_reader_cfg *cfg, int cpu,
+                 int fd, void *ring, size_t ring_pages, FILE *csv) {
+    struct numa_stat *stat = calloc(cfg->topo.nr_nodes + 1, sizeof(*stat));
+    if (!stat) return -1;
+
+    *c = (struct cpu_ctx){.cpu = cpu, .fd = fd, .ring = ring, .ring_pages = ring_pages,
+                          .poll_us = POLL_US, .csv = csv, .cfg = cfg, .stat = stat};
+    page_flags_cache_init(&c->pfc);
+    if (cfg->maps_dir && !(c->maps_seen = calloc(1, sizeof(*c->maps_seen)))) {
+        free(stat);
+        return -1;
+    }
+    return 0;
+}
+
+void cpu_ctx_free(struct cpu_ctx *c) {
+    free(c->stat);
+    c->stat = NULL;
+    page_flags_cache_free(&c->pfc);
+    maps_seen_free(c->maps_seen);
+    c->maps_seen = NULL;
+}
+
+static void account_sample(struct cpu_ctx *c, int node, int src, int l3_miss,
+                           int tlb_miss) {
+    struct numa_stat *st = &c->stat[node < 0 ? c->cfg->topo.nr_nodes : node];
+    st->samples++;
+    st->l3_miss += l3_miss != 0;
+    st->tlb_miss += tlb_miss != 0;
+    st->src[src]++;
+}
+
+static double pct(uint64_t part, uint64_t total) {
+    return total ? 100.0 * part / total : 0.0;
+}
+
+/* print the cpu x node matrix and dump the raw counters as CSV */
+void report_numa(const struct ibs_reader_cfg *cfg, struct cpu_ctx *ctx, int ncpu,
+                 const char *path) {
+    const struct numa_topology *topo = &cfg->topo;
+    int ncol = topo->nr_nodes + 1;
+    FILE *f = fopen(path, "w");
+    if (!f)
+        perror("fopen numa matrix");
+    else
+        fprintf(f, "cpu,cpu_node,mem_node,samples,l3_miss,tlb_miss,"
+                   "loc_cache,loc_dram,rem_dram,rem_cache,cxl\n");
+
+    printf("\nAccess matrix: samples (L3 miss %%) per sampling cpu x memory node\n");
+    printf("%-10s", "cpu(node)");
+    for (int n = 0; n < topo->nr_nodes; n++) printf("        node%-4d", n);
+    printf("        %-8s\n", "unknown");
+
+    struct numa_stat *node_sum = calloc(ncol, sizeof(*node_sum));
+    for (int i = 0; i < ncpu; i++) {
+        int cpu = ctx[i].cpu;
+        uint64_t row = 0;
+        for (int n = 0; n < ncol; n++) row += ctx[i].stat[n].samples;
+        if (!row) continue;
+
+        char label[32];
+        snprintf(label, sizeof(label), "%d(%d)", cpu, numa_node_of_cpu(topo, cpu));
+        printf("%-10s", label);
+        for (int n = 0; n < ncol; n++) {
+            struct numa_stat *st = &ctx[i].stat[n];
+            printf(" %8" PRIu64 "(%5.1f%%)", st->samples, pct(st->l3_miss, st->samples));
+
+            if (node_sum) {
+                node_sum[n].samples += st->samples;
+                node_sum[n].l3_miss += st->l3_miss;
+                node_sum[n].tlb_miss += st->tlb_miss;
+                for (int k = 0; k < MEM_SRC_NR; k++) node_sum[n].src[k] += st->src[k];
+            }
+            if (f && st->samples)
+                fprintf(f, "%d,%d,%d,%" PRIu64 ",%" PRIu64 ",%" PRIu64 ",%" PRIu64
+                           ",%" PRIu64 ",%" PRIu64 ",%" PRIu64 ",%" PRIu64 "\n",
+                        cpu, numa_node_of_cpu(topo, cpu), n < topo->nr_nodes ? n : -1,
+                        st->samples, st->l3_miss, st->tlb_miss,
+                        st->src[MEM_SRC_LOCAL_CACHE], st->src[MEM_SRC_LOCAL_DRAM],
+                        st->src[MEM_SRC_REMOTE_DRAM], st->src[MEM_SRC_REMOTE_CACHE],
+                        st->src[MEM_SRC_CXL]);
+        }
+        printf("\n");
+    }
+
+    if (node_sum) {
+        printf("\nPer memory node: samples, L3/TLB miss rate, source breakdown\n");
+        for (int n = 0; n < ncol; n++) {
+            struct numa_stat *st = &node_sum[n];
+            if (!st->samples) continue;
+            if (n < topo->nr_nodes)
+                printf("node%-4d", n);
+            else
+                printf("%-8s", "unknown");
+            printf(" samples %-10" PRIu64 " l3_miss %5.1f%% tlb_miss %5.1f%%",
+                   st->samples, pct(st->l3_miss, st->samples),
+                   pct(st->tlb_miss, st->samples));
+            for (int k = MEM_SRC_LOCAL_CACHE; k < MEM_SRC_OTHER; k++)
+                printf(" %s %" PRIu64, mem_src_str(k), st->src[k]);
+            printf("\n");
+        }
+        free(node_sum);
+    }
+
+    if (f) {
+        fclose(f);
+        printf("NUMA matrix written into %s\n", path);
+    }
+}
+
+static void handle_sample(struct cpu_ctx *c, struct perf_event_header *h) {
+    const struct ibs_reader_cfg *cfg = c->cfg;
+    char *raw = (char *)(h + 1);
+
+    /* according sample_type, parse the field */
+    uint64_t ip = NEXT(uint64_t);        /* PERF_SAMPLE_IP */
+    uint64_t pid_tid = NEXT(uint64_t);   /* PERF_SAMPLE_TID */
+    uint64_t ts = NEXT(uint64_t);        /* PERF_SAMPLE_TIME */
+    uint64_t lin_addr = NEXT(uint64_t);  /* PERF_SAMPLE_ADDR */
+    uint64_t id = NEXT(uint64_t);        /* PERF_SAMPLE_ID */
+    uint64_t cpu_res = NEXT(uint64_t);   /* PERF_SAMPLE_CPU */
+    uint64_t data_src = NEXT(uint64_t);  /* PERF_SAMPLE_DATA_SRC */
+    uint64_t phys_addr = NEXT(uint64_t); /* PERF_SAMPLE_PHYS_ADDR */
+
+    (void)id; /* unused */
+
+    uint32_t pid = pid_tid & 0xffffffff;
+    uint32_t tid = pid_tid >> 32;
+    uint32_t cpu = cpu_res & 0xffffffff;
+
+    int l3_miss = is_llc_miss(data_src);
+    int tlb_miss = is_tlb_miss(data_src);
+
+    phys_addr &= ((1ULL << 52) - 1);
+
+    int mem_node = phys_addr ? numa_node_of_phys(&cfg->topo, phys_addr) : -1;
+    int mem_src = classify_mem_src(data_src);
+    account_sample(c, mem_node, mem_src, l3_miss, tlb_miss);
+    c->samples++;
+
+    if (cfg->maps_dir) maps_snapshot_pid(c->maps_seen, cfg->maps_dir, pid, ip, ts);
+
+    if (cfg->output == IBS_OUTPUT_STATS) return;
+
+    struct workload_tag tag = {0};
+    if (cfg->tags) workload_tag_lookup(cfg->tags, pid, tid, &tag);
+
+    struct page_info pinfo = {0};
+    char flags_str[48] = "-";
+    if (cfg->page_flags_on &&
+        page_info_lookup(&c->pfc, pid, lin_addr, phys_addr, &pinfo) == 0)
+        page_flags_str(pinfo.flags, flags_str, sizeof(flags_str));
+
+    char decode_str[128];
+    get_data_src_decode_str(data_src, decode_str, sizeof(decode_str));
+
+    fprintf(c->csv,
+            "%" PRIu64
+            ",%u,%u,%u,0x%llx,0x%llx,0x%llx,0x%llx,%s,%d,%s,%s,%" PRIu64
+            ",0x%" PRIx64 ",%" PRIu64 ",%s\n",
+            ts, pid, tid, cpu,
+            (unsigned long long)ip,
+            (unsigned long long)lin_addr,
+            (unsigned long long)phys_addr,
+            (unsigned long long)data_src,
+            decode_str, mem_node, mem_src_str(mem_src),
+            workload_phase_str(tag.phase), tag.op_index, tag.key_id,
+            pinfo.page_size, flags_str);
+
+    /* For debugging, show data_src */
+    if (cfg->debug_datasrc) {
+        decode_data_src(data_src);
+    }
+}
+
+void *cpu_loop(void *arg) {
+    struct cpu_ctx *c = arg;
+    volatile int *running = c->cfg->running;
+    const size_t pg = sysconf(_SC_PAGESIZE);
+    const size_t ring_sz = c->ring_pages * pg;
+    const size_t mask = ring_sz - 1;
+    struct perf_event_mmap_page *meta = c->ring;
+    char *data = (char *)meta + pg;
+    char scratch[SCRATCH_SZ];
+
+    /* pin thread */
+    if (c->cpu >= 0) {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(c->cpu, &set);
+        sched_setaffinity(0, sizeof(set), &set);
+    }
+
+    uint64_t last_flush = mono_ns();
+
+    while (*running) {
+        uint64_t head = meta->data_head;
+        rmb();
+
+        uint64_t lag = head - meta->data_tail;
+        c->polls++;
+        c->lag_sum += lag;
+        if (lag > c->lag_max) c->lag_max = lag;
+
+        while (meta->data_tail != head) {
+            uint64_t tail = meta->data_tail & mask;
+            struct perf_event_header *h = (void *)(data + tail);
+
+            /* if record cross ring tail, move to scratch */
+            if (tail + h->size > ring_sz) {
+                size_t first = ring_sz - tail;
+                if (h->size > SCRATCH_SZ) {
+                    fprintf(stderr, "record too large: %u\n", h->size);
+                    *running = 0;
+                    break;
+                }
+                memcpy(scratch, data + tail, first);
+                memcpy(scratch + first, data, h->size - first);
+                h = (struct perf_event_header *)scratch;
+            }
+
+            if (h->type == PERF_RECORD_SAMPLE) {
+                handle_sample(c, h);
+            } else if (h->type == PERF_RECORD_LOST) {
+                /* struct { header; u64 id; u64 lost; sample_id } */
+                c->lost += ((uint64_t *)(h + 1))[1];
+            }
+            meta->data_tail += h->size;
+        }
+        wmb();
+
+        if (c->csv && mono_ns() - last_flush > 1e9) {
+            fflush(c->csv);
+            last_flush = mono_ns();
+        }
+        usleep(c->poll_us);
+    }
+    return NULL;
+}
@@ -0,0 +1,71 @@
+#ifndef IBS_RING_H
+#define IBS_RING_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "data_src_decoder.h"
+#include "maps_snapshot.h"
+#include "numa_topology.h"
+#include "page_flags.h"
+#include "workload_tag.h"
+
+#define RING_PAGES 8
+#define SCRATCH_SZ 4096
+#define POLL_US 3000
+
+enum ibs_output {
+    IBS_OUTPUT_CSV = 0, /* one CSV row per sample */
+    IBS_OUTPUT_STATS,   /* only the NUMA matrix counters, no per-sample rows */
+    IBS_OUTPUT_NR,
+};
+
+/* read-only state shared by all reader threads */
+struct ibs_reader_cfg {
+    volatile int *running;
+    int output;
+    int debug_datasrc;
+    int page_flags_on;
+    struct numa_topology topo;
+    struct workload_tag_table *tags;
+    const char *maps_dir;   /* save /proc/<pid>/maps here, NULL = off */
+};
+
+/* per (sampling cpu, memory node) counters, the last slot is "node unknown" */
+struct numa_stat {
+    uint64_t samples;
+    uint64_t l3_miss;
+    uint64_t tlb_miss;
+    uint64_t src[MEM_SRC_NR];
+};
+
+struct cpu_ctx {
+    int cpu;                /* cpu to pin the reader to, -1 leaves it unpinned */
+    int fd;
+    void *ring;             /* perf mmap: meta page + ring_pages data pages */
+    size_t ring_pages;
+    unsigned poll_us;
+    FILE *csv;
+    const struct ibs_reader_cfg *cfg;
+    struct numa_stat *stat; /* cfg->topo.nr_nodes + 1 entries */
+    struct page_flags_cache pfc;
+    struct maps_seen *maps_seen; /* only with cfg->maps_dir */
+
+    /* drain counters */
+    uint64_t samples;
+    uint64_t lost;          /* reported by PERF_RECORD_LOST */
+    uint64_t polls;
+    uint64_t lag_sum;       /* bytes pending at the start of each poll */
+    uint64_t lag_max;
+};
+
+uint64_t mono_ns(void);
+int cpu_ctx_init(struct cpu_ctx *c, const struct ibs_reader_cfg *cfg, int cpu,
+                 int fd, void *ring, size_t ring_pages, FILE *csv);
+void cpu_ctx_free(struct cpu_ctx *c);
+void *cpu_loop(void *arg);
+void report_numa(const struct ibs_reader_cfg *cfg, struct cpu_ctx *ctx, int ncpu,
+                 const char *path);
+
+#endif // IBS_RING_H
@@ -0,0 +1,234 @@
+/*
+ * maps_snapshot.c  ——  keep /proc/<pid>/maps and /proc/kallsyms for symbolizing
+ *
+ *   <dir>/kallsyms     copied once at start (needs root for real addresses)
+ *   <dir>/<pid>.maps   copied the first time a pid shows up in a sample,
+ *                      appended to when its maps change
+ *
+ * Short lived processes are gone by the time ibs_samples.csv is looked at, so
+ * the copy is taken during collection. The file is created with O_EXCL, the
+ * first reader thread to see a pid writes it and the others skip.
+ *
+ * Each thread keeps the executable ranges it read for a pid. A user ip
+ * outside all of them means a dlopen, exec or JIT region that came later:
+ * the maps are read again and appended under flock, at most once per
+ * MAPS_RESNAP_NS of sample time per pid and thread. Later lines win where
+ * they overlap earlier ones. Function_Address_Lookup/ip_symbolizer reads
+ * the directory.
+ */
+#define _GNU_SOURCE
+#include "maps_snapshot.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static int copy_file(const char *src, const char *dst) {
+    int in = open(src, O_RDONLY | O_CLOEXEC);
+    if (in < 0) return -1;
+    int out = open(dst, O_WRONLY | O_CREAT | O_CLOEXEC | O_TRUNC, 0644);
+    if (out < 0) {
+        close(in);
+        return -1;
+    }
+
+    char buf[16384];
+    ssize_t n;
+    while ((n = read(in, buf, sizeof(buf))) > 0) {
+        if (write(out, buf, n) != n) {
+            n = -1;
+            break;
+        }
+    }
+    close(in);
+    close(out);
+    return n < 0 ? -1 : 0;
+}
+
+int maps_snapshot_init(const char *dir) {
+    if (mkdir(dir, 0755) < 0 && errno != EEXIST) {
+        perror("mkdir maps snapshot dir");
+        return -1;
+    }
+
+    char path[512];
+    snprintf(path, sizeof(path), "%s/kallsyms", dir);
+    if (copy_file("/proc/kallsyms", path) < 0) {
+        perror("copy /proc/kallsyms");
+        return -1;
+    }
+    return 0;
+}
+
+#define KERNEL_IP_START 0xffff800000000000ULL
+
+/* whole /proc/<pid>/maps in a malloc'ed buffer, NULL if the pid is gone */
+static char *read_maps(uint32_t pid, size_t *len) {
+    char path[64];
+    snprintf(path, sizeof(path), "/proc/%u/maps", pid);
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return NULL;
+
+    size_t cap = 16384, n = 0;
+    char *buf = malloc(cap);
+    ssize_t r = 0;
+    while (buf && (r = read(fd, buf + n, cap - n)) > 0) {
+        n += r;
+        if (n == cap) {
+            char *nb = realloc(buf, cap * 2);
+            if (!nb) {
+                free(buf);
+                buf = NULL;
+                break;
+            }
+            buf = nb;
+            cap *= 2;
+        }
+    }
+    close(fd);
+    if (buf && (r < 0 || !n)) {
+        free(buf);
+        buf = NULL;
+    }
+    *len = n;
+    return buf;
+}
+
+/* keep the executable ranges of buf in p->x */
+static void parse_exec_ranges(struct maps_pid *p, const char *buf, size_t len) {
+    uint32_t nr = 0, cap = 0;
+    uint64_t *x = NULL;
+    for (const char *line = buf, *end = buf + len; line < end;) {
+        const char *eol = memchr(line, '\n', end - line);
+        if (!eol) eol = end;
+        unsigned long long lo, hi;
+        char perms[5];
+        if (sscanf(line, "%llx-%llx %4s", &lo, &hi, perms) == 3 && perms[2] == 'x') {
+            if (nr == cap) {
+                uint32_t ncap = cap ? cap * 2 : 32;
+                uint64_t *nx = realloc(x, ncap * 2 * sizeof(*x));
+                if (!nx) break;
+                x = nx;
+                cap = ncap;
+            }
+            x[2 * nr] = lo;
+            x[2 * nr + 1] = hi;
+            nr++;
+        }
+        line = eol + 1;
+    }
+    free(p->x);
+    p->x = x;
+    p->nr = nr;
+}
+
+static int in_exec_range(const struct maps_pid *p, uint64_t ip) {
+    for (uint32_t i = 0; i < p->nr; i++)
+        if (p->x[2 * i] <= ip && ip < p->x[2 * i + 1]) return 1;
+    return 0;
+}
+
+static void write_all(int fd, const char *buf, size_t len) {
+    while (len) {
+        ssize_t n = write(fd, buf, len);
+        if (n <= 0) return;
+        buf += n;
+        len -= n;
+    }
+}
+
+/* read the maps of p's pid, save them (first time: create, else append) */
+static void snapshot(struct maps_pid *p, const char *dir, int first) {
+    size_t len;
+    char *buf = read_maps(p->key - 1, &len);
+    if (!buf) return;
+    parse_exec_ranges(p, buf, len);
+
+    char dst[512];
+    snprintf(dst, sizeof(dst), "%s/%u.maps", dir, p->key - 1);
+    /* EEXIST on first: another thread already has it */
+    int fd = open(dst, O_WRONLY | O_CLOEXEC | (first ? O_CREAT | O_EXCL : O_APPEND), 0644);
+    if (fd >= 0) {
+        flock(fd, LOCK_EX);
+        write_all(fd, buf, len);
+        close(fd);
+    }
+    free(buf);
+}
+
+static struct maps_pid *seen_insert(struct maps_pid *tab, uint32_t slots, uint32_t key) {
+    uint32_t mask = slots - 1;
+    uint32_t h = ((key - 1) * 2654435761u) & mask;
+    while (tab[h].key) h = (h + 1) & mask;
+    tab[h].key = key;
+    return &tab[h];
+}
+
+/* double the table, 0 on failure */
+static int seen_grow(struct maps_seen *seen) {
+    uint32_t slots = seen->slots ? seen->slots * 2 : MAPS_SEEN_SLOTS;
+    struct maps_pid *tab = calloc(slots, sizeof(*tab));
+    if (!tab) return 0;
+    for (uint32_t i = 0; i < seen->slots; i++)
+        if (seen->pid[i].key) *seen_insert(tab, slots, seen->pid[i].key) = seen->pid[i];
+    free(seen->pid);
+    seen->pid = tab;
+    seen->slots = slots;
+    return 1;
+}
+
+/*
+ * The entry of pid, *added set when it is new. The table grows so a long
+ * run with many pids does not pay an open() for every sample of a pid it
+ * could not record; if it cannot grow, new pids are skipped (NULL) rather
+ * than retried.
+ */
+static struct maps_pid *seen_get(struct maps_seen *seen, uint32_t pid, int *added) {
+    uint32_t key = pid + 1;
+
+    *added = 0;
+    if (seen->slots) {
+        uint32_t mask = seen->slots - 1;
+        for (uint32_t h = (pid * 2654435761u) & mask; seen->pid[h].key; h = (h + 1) & mask)
+            if (seen->pid[h].key == key) return &seen->pid[h];
+    }
+    /* keep a quarter free so misses stay short */
+    if (seen->used >= seen->slots / 4 * 3 && !seen_grow(seen)) {
+        static int warned;
+        if (!__atomic_exchange_n(&warned, 1, __ATOMIC_RELAXED))
+            fprintf(stderr, "maps snapshot: out of memory, not saving maps of new pids\n");
+        return NULL;
+    }
+    seen->used++;
+    *added = 1;
+    return seen_insert(seen->pid, seen->slots, key);
+}
+
+void maps_snapshot_pid(struct maps_seen *seen, const char *dir, uint32_t pid, uint64_t ip,
+                       uint64_t time_ns) {
+    if (!pid || pid == (uint32_t)-1) return;
+
+    int added;
+    struct maps_pid *p = seen_get(seen, pid, &added);
+    if (!p) return;
+    if (added) {
+        snapshot(p, dir, 1);
+        p->next_ns = time_ns + MAPS_RESNAP_NS;
+        return;
+    }
+    if (!ip || ip >= KERNEL_IP_START || time_ns < p->next_ns || in_exec_range(p, ip)) return;
+    snapshot(p, dir, 0);
+    p->next_ns = time_ns + MAPS_RESNAP_NS;
+}
+
+void maps_seen_free(struct maps_seen *seen) {
+    if (!seen) return;
+    for (uint32_t i = 0; i < seen->slots; i++) free(seen->pid[i].x);
+    free(seen->pid);
+    free(seen);
+}
@@ -0,0 +1,29 @@
+#ifndef MAPS_SNAPSHOT_H
+#define MAPS_SNAPSHOT_H
+
+#include <stdint.h>
+
+#define MAPS_SEEN_SLOTS 1024 /* initial size, power of two, doubles at 3/4 */
+#define MAPS_RESNAP_NS 1000000000ULL /* at most one re-snapshot per pid and thread per second */
+
+/* a pid whose maps were saved, with the executable ranges this thread read */
+struct maps_pid {
+    uint32_t key;       /* pid + 1, 0 marks an empty slot */
+    uint32_t nr;        /* start/end pairs in x */
+    uint64_t next_ns;   /* no re-snapshot before this sample time */
+    uint64_t *x;
+};
+
+/* per reader thread: pids whose maps were already saved, zeroed to start */
+struct maps_seen {
+    struct maps_pid *pid;
+    uint32_t slots;
+    uint32_t used;
+};
+
+int maps_snapshot_init(const char *dir);
+void maps_snapshot_pid(struct maps_seen *seen, const char *dir, uint32_t pid, uint64_t ip,
+                       uint64_t time_ns);
+void maps_seen_free(struct maps_seen *seen);
+
+#endif // MAPS_SNAPSHOT_H
@@ -7,6 +7,9 @@ mem_block_hotness.py  ─ 0x0000 ~ 0x0FFFFFFF
 • show the heat graph first，and show the hist bar (Top-N page)。
 • support PID filter，only show target PID memory access info。
 • support image saving functionality
+• --mapping: count at the real mapping size (4K / 2M THP / 1G hugetlb) using
+  the page_size column written by `IBS_PAGE_FLAGS=1 ./ibs_reader`, and print a
+  per-page-size breakdown of accesses and L3 misses
 """
 
 from __future__ import annotations
@@ -35,6 +38,10 @@ def parse_args() -> argparse.Namespace:
     ap.add_argument("--pid", type=int, nargs="+", help="Filter by PID(s) - can specify multiple PIDs")
     ap.add_argument("--bar", action="store_true", help="also draw bar chart (Top-N)")
     ap.add_argument("--top", type=int, default=50, help="Top-N pages for bar chart")
+    ap.add_argument("--mapping", action="store_true",
+                    help="aggregate at the real mapping size (needs IBS_PAGE_FLAGS=1 samples)")
+    ap.add_argument("--page-size-index", type=int, default=14, help="page_size column index (0-based)")
+    ap.add_argument("--src-index", type=int, default=10, help="mem_src column index (0-based)")
     
     ap.add_argument("--save", action="store_true", help="Save plots to files instead of displaying")
     ap.add_argument("--output-dir", type=Path, default=".", help="Output directory for saved plots")
@@ -49,6 +56,17 @@ PAGE_SHIFT = 12               # 4 KiB
 N_ROWS     = 256              # 2⁸
 N_COLS     = 256              # 2⁸
 
+# mem_src classes served from beyond the local L3
+MISS_SRCS  = {"LOC_DRAM", "REM_DRAM", "REM_CACHE", "CXL"}
+
+
+def size_label(size: int) -> str:
+    if size >= 1 << 30:
+        return f"{size >> 30}G"
+    if size >= 1 << 20:
+        return f"{size >> 20}M"
+    return f"{size >> 10}K"
+
 def load_addrs(path: Path, phys_addr_col: int, pid_col: int, delim: str, hdr: bool, pids: Optional[List[int]] = None) -> List[int]:
     """
     load physical addresses from CSV, optionally filtering by PID(s)
@@ -112,6 +130,52 @@ def load_addrs(path: Path, phys_addr_col: int, pid_col: int, delim: str, hdr: bo
     return result
 
 
+def load_mapped(path: Path, phys_addr_col: int, pid_col: int, size_col: int, src_col: int,
+                delim: str, hdr: bool, pids: Optional[List[int]] = None) -> pd.DataFrame:
+    """
+    load phys_addr / page_size / mem_src, return one row per sample with the
+    base address of the mapping it falls in (4 KiB when the size is unknown)
+    """
+    names = {pid_col: "pid", phys_addr_col: "phys_addr", size_col: "page_size", src_col: "mem_src"}
+    df = pd.read_csv(
+        path, sep=delim, header=0 if hdr else None,
+        usecols=list(names), dtype=str, engine="c"
+    )
+    # usecols keeps file order, rename by position
+    df.columns = [names[c] for c in sorted(names)]
+
+    if pids is not None:
+        df = df[df["pid"].astype(int).isin(pids)]
+
+    df = df[df["phys_addr"].str.strip().str.startswith("0x")]
+    phys = df["phys_addr"].map(lambda x: int(x, 16))
+    size = pd.to_numeric(df["page_size"], errors="coerce").fillna(0).astype("int64")
+    size = size.where(size > 0, 1 << PAGE_SHIFT)
+
+    out = pd.DataFrame({
+        "phys_addr": phys.values,
+        "page_size": size.values,
+        "miss": df["mem_src"].str.strip().isin(MISS_SRCS).values,
+    })
+    out = out[(out["phys_addr"] > 0) & (out["phys_addr"] <= MAX_ADDR)]
+    out["base"] = out["phys_addr"].values & ~(out["page_size"].values - 1)
+
+    print(f"[Debug] mapped samples: {len(out)}")
+    return out
+
+
+def print_size_breakdown(df: pd.DataFrame):
+    """accesses / misses per page size, counted once per real mapping"""
+    print("\n[Info] Per page size breakdown")
+    print(f"{'size':>6} {'pages':>10} {'accesses':>12} {'misses':>10} {'miss%':>7} {'acc/page':>9}")
+    for size, grp in df.groupby("page_size"):
+        pages = grp["base"].nunique()
+        acc = len(grp)
+        miss = int(grp["miss"].sum())
+        print(f"{size_label(size):>6} {pages:>10} {acc:>12} {miss:>10} "
+              f"{100.0 * miss / acc:>6.1f}% {acc / pages:>9.1f}")
+
+
 def draw_heatmap(counter: Counter[int], pids: Optional[List[int]] = None, save_path: Optional[Path] = None, dpi: int = 300):
     """draw heatmap, support saving to file"""
     mat = np.zeros((N_ROWS, N_COLS), dtype=int)
@@ -143,7 +207,8 @@ def draw_heatmap(counter: Counter[int], pids: Optional[List[int]] = None, save_p
         plt.show()
 
 
-def draw_bar(counter: Counter[int], top_n: int, pids: Optional[List[int]] = None, save_path: Optional[Path] = None, dpi: int = 300):
+def draw_bar(counter: Counter[int], top_n: int, pids: Optional[List[int]] = None, save_path: Optional[Path] = None, dpi: int = 300,
+             sizes: Optional[dict] = None):
     """draw bar chart, support saving to file"""
     items = counter.most_common(top_n)
     if not items:
@@ -151,6 +216,10 @@ def draw_bar(counter: Counter[int], top_n: int, pids: Optional[List[int]] = None
         return
         
     labels = [f"0x{page << PAGE_SHIFT:010x}" for page, _ in items]
+    if sizes:
+        labels = [f"{lbl} ({size_label(sizes.get(page, 1 << PAGE_SHIFT))})"
+                  for lbl, (page, _) in zip(labels, items)]
+    unit = "real mapping size" if sizes else "4 KiB"
     counts = [cnt for _, cnt in items]
 
     fig_width = max(10, 0.4 * len(items))
@@ -168,9 +237,9 @@ def draw_bar(counter: Counter[int], top_n: int, pids: Optional[List[int]] = None
     ax.set_xlabel("Physical Address (Page)", fontsize=11)
     
     if pids:
-        title = f"Top-{top_n} Hottest Memory Pages (PID: {', '.join(map(str, pids))})\n4 KiB per page"
+        title = f"Top-{top_n} Hottest Memory Pages (PID: {', '.join(map(str, pids))})\n{unit} per page"
     else:
-        title = f"Top-{top_n} Hottest Memory Pages\n4 KiB per page"
+        title = f"Top-{top_n} Hottest Memory Pages\n{unit} per page"
     
     ax.set_title(title, fontsize=12, pad=15)
     ax.yaxis.set_major_locator(MaxNLocator(integer=True))
@@ -192,25 +261,38 @@ def main():
     if args.save:
         args.output_dir.mkdir(parents=True, exist_ok=True)
 
-    # Load address data (optionally filter by PID)
-    addrs = load_addrs(
-        args.csv, 
-        args.index, 
-        args.pid_index, 
-        args.delimiter, 
-        args.header,
-        args.pid
-    )
-    
-    if not addrs:
-        print("[Error] No valid memory address data found")
-        return
+    sizes = None
+    if args.mapping:
+        # count per real mapping, a THP / hugetlb page is one entry
+        df = load_mapped(args.csv, args.index, args.pid_index, args.page_size_index,
+                         args.src_index, args.delimiter, args.header, args.pid)
+        if df.empty:
+            print("[Error] No valid memory address data found")
+            return
+        print_size_breakdown(df)
+        pages = (df["base"] // (1 << PAGE_SHIFT)).tolist()
+        sizes = dict(zip(pages, df["page_size"].tolist()))
+        cnt = Counter(pages)
+    else:
+        # Load address data (optionally filter by PID)
+        addrs = load_addrs(
+            args.csv, 
+            args.index, 
+            args.pid_index, 
+            args.delimiter, 
+            args.header,
+            args.pid
+        )
+        
+        if not addrs:
+            print("[Error] No valid memory address data found")
+            return
 
-    print(f"[Info] Total processed {len(addrs)} memory addresses")
+        print(f"[Info] Total processed {len(addrs)} memory addresses")
 
-    # Convert to page numbers and count accesses
-    pages = [addr >> PAGE_SHIFT for addr in addrs]
-    cnt = Counter(pages)
+        # Convert to page numbers and count accesses
+        pages = [addr >> PAGE_SHIFT for addr in addrs]
+        cnt = Counter(pages)
 
     print(f"[Info] Found {len(cnt)} different memory pages")
 
@@ -244,7 +326,7 @@ def main():
 
     # If requested, draw bar chart
     if args.bar:
-        draw_bar(cnt, args.top, args.pid, bar_path, args.dpi)
+        draw_bar(cnt, args.top, args.pid, bar_path, args.dpi, sizes)
     
     if args.save:
         print(f"\n[Info] All images saved to directory: {args.output_dir}")
@@ -0,0 +1,144 @@
+/*
+ * numa_topology.c  ——  physical address / cpu -> NUMA node lookup
+ *
+ *   /sys/devices/system/memory/block_size_bytes    memory block size (hex)
+ *   /sys/devices/system/node/nodeN/memoryM         block M belongs to node N
+ *   /sys/devices/system/node/nodeN/cpuK            cpu K belongs to node N
+ *
+ * Memory-only nodes (CXL expanders, PMEM) show up here as nodes without cpus.
+ */
+#include "numa_topology.h"
+
+#include <dirent.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define NODE_ROOT "/sys/devices/system/node"
+#define BLOCK_SIZE_PATH "/sys/devices/system/memory/block_size_bytes"
+
+static int cmp_range(const void *a, const void *b) {
+    const struct numa_range *x = a, *y = b;
+    if (x->start < y->start) return -1;
+    return x->start > y->start;
+}
+
+static int read_block_size(uint64_t *bs) {
+    FILE *f = fopen(BLOCK_SIZE_PATH, "r");
+    if (!f) {
+        perror("open " BLOCK_SIZE_PATH);
+        return -1;
+    }
+    unsigned long long v;
+    int ok = fscanf(f, "%llx", &v) == 1 && v > 0;
+    fclose(f);
+    if (!ok) return -1;
+    *bs = v;
+    return 0;
+}
+
+static int push_range(struct numa_topology *t, size_t *cap, uint64_t start,
+                      uint64_t end, int node) {
+    if (t->nr_ranges == *cap) {
+        size_t ncap = *cap ? *cap * 2 : 256;
+        struct numa_range *r = realloc(t->ranges, ncap * sizeof(*r));
+        if (!r) return -1;
+        t->ranges = r;
+        *cap = ncap;
+    }
+    t->ranges[t->nr_ranges++] = (struct numa_range){start, end, node};
+    return 0;
+}
+
+/* merge adjacent blocks of the same node so lookups stay short */
+static void merge_ranges(struct numa_topology *t) {
+    if (t->nr_ranges == 0) return;
+    qsort(t->ranges, t->nr_ranges, sizeof(*t->ranges), cmp_range);
+    size_t out = 0;
+    for (size_t i = 1; i < t->nr_ranges; i++) {
+        struct numa_range *last = &t->ranges[out];
+        if (t->ranges[i].node == last->node && t->ranges[i].start == last->end)
+            last->end = t->ranges[i].end;
+        else
+            t->ranges[++out] = t->ranges[i];
+    }
+    t->nr_ranges = out + 1;
+}
+
+int numa_topology_load(struct numa_topology *t, int nr_cpus) {
+    memset(t, 0, sizeof(*t));
+    t->nr_cpus = nr_cpus;
+    t->cpu_node = malloc(nr_cpus * sizeof(int));
+    if (!t->cpu_node) return -1;
+    for (int i = 0; i < nr_cpus; i++) t->cpu_node[i] = -1;
+
+    uint64_t bs;
+    if (read_block_size(&bs) < 0) return -1;
+
+    DIR *root = opendir(NODE_ROOT);
+    if (!root) {
+        perror("open " NODE_ROOT);
+        return -1;
+    }
+
+    size_t cap = 0;
+    struct dirent *de;
+    while ((de = readdir(root))) {
+        int node;
+        if (sscanf(de->d_name, "node%d", &node) != 1) continue;
+
+        char path[512];
+        snprintf(path, sizeof(path), NODE_ROOT "/%s", de->d_name);
+        DIR *nd = opendir(path);
+        if (!nd) continue;
+
+        if (node + 1 > t->nr_nodes) t->nr_nodes = node + 1;
+
+        struct dirent *e;
+        while ((e = readdir(nd))) {
+            unsigned long blk;
+            int cpu;
+            if (sscanf(e->d_name, "memory%lu", &blk) == 1) {
+                if (push_range(t, &cap, blk * bs, (blk + 1) * bs, node) < 0) {
+                    closedir(nd);
+                    closedir(root);
+                    return -1;
+                }
+            } else if (sscanf(e->d_name, "cpu%d", &cpu) == 1 &&
+                       cpu >= 0 && cpu < nr_cpus) {
+                t->cpu_node[cpu] = node;
+            }
+        }
+        closedir(nd);
+    }
+    closedir(root);
+
+    merge_ranges(t);
+    return t->nr_nodes > 0 ? 0 : -1;
+}
+
+void numa_topology_free(struct numa_topology *t) {
+    free(t->ranges);
+    free(t->cpu_node);
+    memset(t, 0, sizeof(*t));
+}
+
+int numa_node_of_phys(const struct numa_topology *t, uint64_t phys_addr) {
+    size_t lo = 0, hi = t->nr_ranges;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        const struct numa_range *r = &t->ranges[mid];
+        if (phys_addr < r->start)
+            hi = mid;
+        else if (phys_addr >= r->end)
+            lo = mid + 1;
+        else
+            return r->node;
+    }
+    return -1;
+}
+
+int numa_node_of_cpu(const struct numa_topology *t, int cpu) {
+    if (!t->cpu_node || cpu < 0 || cpu >= t->nr_cpus) return -1;
+    return t->cpu_node[cpu];
+}
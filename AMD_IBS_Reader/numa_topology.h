@@ -0,0 +1,27 @@
+#ifndef NUMA_TOPOLOGY_H
+#define NUMA_TOPOLOGY_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* one contiguous physical range owned by a NUMA node */
+struct numa_range {
+    uint64_t start;
+    uint64_t end; /* exclusive */
+    int node;
+};
+
+struct numa_topology {
+    int nr_nodes;               /* highest node id + 1 */
+    struct numa_range *ranges;  /* sorted by start */
+    size_t nr_ranges;
+    int *cpu_node;              /* cpu -> node, -1 when unknown */
+    int nr_cpus;
+};
+
+int numa_topology_load(struct numa_topology *t, int nr_cpus);
+void numa_topology_free(struct numa_topology *t);
+int numa_node_of_phys(const struct numa_topology *t, uint64_t phys_addr);
+int numa_node_of_cpu(const struct numa_topology *t, int cpu);
+
+#endif // NUMA_TOPOLOGY_H
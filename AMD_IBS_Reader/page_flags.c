@@ -0,0 +1,194 @@
+/*
+ * page_flags.c  ——  resolve sampled pages through pagemap / kpageflags
+ *
+ *   /proc/<pid>/pagemap   vaddr -> pfn, present / file bits   (8 bytes per 4K)
+ *   /proc/kpageflags      pfn   -> KPF_* page flags           (8 bytes per pfn)
+ *
+ * pagemap is only read when the sample has no phys_addr.
+ * The mapping size is taken from the compound page around the pfn:
+ *   THP      2M-aligned head followed by 511 tails, otherwise a small (m)THP
+ *            folio which is reported at 4K granularity
+ *   hugetlb  1G when the 1G-aligned pfn is a head and +2M is still a tail,
+ *            otherwise 2M
+ * Both files need root (CAP_SYS_ADMIN for pfns in pagemap).
+ */
+#define _GNU_SOURCE
+#include "page_flags.h"
+
+#include <fcntl.h>
+#include <linux/kernel-page-flags.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#define PM_PFN_MASK  ((1ULL << 55) - 1)
+#define PM_FILE      (1ULL << 61)
+#define PM_PRESENT   (1ULL << 63)
+
+#define USER_VA_END  (1ULL << 56) /* pagemap reads past the task size return nothing */
+
+#define KPF(bit) (1ULL << (bit))
+
+#define PFN_4K_SHIFT 12
+#define NR_PFN_2M    512ULL
+#define NR_PFN_1G    (512ULL * 512ULL)
+
+static int kpageflags_fd = -1;
+
+int page_flags_init(void) {
+    kpageflags_fd = open("/proc/kpageflags", O_RDONLY | O_CLOEXEC);
+    if (kpageflags_fd < 0) {
+        perror("open /proc/kpageflags");
+        return -1;
+    }
+    return 0;
+}
+
+void page_flags_exit(void) {
+    if (kpageflags_fd >= 0) close(kpageflags_fd);
+    kpageflags_fd = -1;
+}
+
+void page_flags_cache_init(struct page_flags_cache *pc) {
+    memset(pc, 0, sizeof(*pc));
+    for (int i = 0; i < PAGEMAP_FD_CACHE; i++) pc->fd[i] = -1;
+}
+
+void page_flags_cache_free(struct page_flags_cache *pc) {
+    for (int i = 0; i < PAGEMAP_FD_CACHE; i++)
+        if (pc->fd[i] >= 0) close(pc->fd[i]);
+    page_flags_cache_init(pc);
+}
+
+static int read_u64s(int fd, uint64_t index, uint64_t *buf, size_t n) {
+    ssize_t want = n * sizeof(uint64_t);
+    return pread(fd, buf, want, index * sizeof(uint64_t)) == want ? 0 : -1;
+}
+
+static int pagemap_open(struct page_flags_cache *pc, int slot, uint32_t pid) {
+    if (pc->fd[slot] >= 0) close(pc->fd[slot]);
+
+    char path[64];
+    snprintf(path, sizeof(path), "/proc/%u/pagemap", pid);
+    pc->pid[slot] = pid;
+    pc->fd[slot] = open(path, O_RDONLY | O_CLOEXEC);
+    return pc->fd[slot];
+}
+
+/*
+ * pagemap entry of vaddr in pid. A failed open is cached too. A cached fd
+ * stops reading once its process has exited (EOF or ESRCH), and the pid may
+ * belong to a new process by now, so a failed read reopens it once.
+ */
+static int read_pme(struct page_flags_cache *pc, uint32_t pid, uint64_t vaddr, uint64_t *pme) {
+    uint64_t index = vaddr >> PFN_4K_SHIFT;
+    int slot = -1;
+    for (int i = 0; i < PAGEMAP_FD_CACHE && slot < 0; i++)
+        if (pc->pid[i] == pid) slot = i;
+
+    if (slot >= 0) {
+        if (pc->fd[slot] < 0) return -1;
+        if (read_u64s(pc->fd[slot], index, pme, 1) == 0) return 0;
+    } else {
+        slot = pc->next;
+        pc->next = (pc->next + 1) % PAGEMAP_FD_CACHE;
+    }
+    int fd = pagemap_open(pc, slot, pid);
+    return fd >= 0 ? read_u64s(fd, index, pme, 1) : -1;
+}
+
+static uint32_t to_pgf(uint64_t kpf) {
+    uint32_t f = 0;
+    if (kpf & KPF(KPF_THP)) f |= PGF_THP;
+    if (kpf & KPF(KPF_HUGE)) f |= PGF_HUGETLB;
+    if (kpf & KPF(KPF_ANON))
+        f |= PGF_ANON;
+    else if (kpf & KPF(KPF_MMAP))
+        f |= PGF_FILE;
+    if (kpf & KPF(KPF_DIRTY)) f |= PGF_DIRTY;
+    if (kpf & KPF(KPF_LRU)) f |= PGF_LRU;
+    return f;
+}
+
+/* THP: is pfn inside a PMD-sized folio? one 4K read covers the 2M window */
+static int is_pmd_thp(uint64_t pfn) {
+    uint64_t win[NR_PFN_2M];
+    uint64_t base = pfn & ~(NR_PFN_2M - 1);
+    if (read_u64s(kpageflags_fd, base, win, NR_PFN_2M) < 0) return 0;
+    if (!(win[0] & KPF(KPF_COMPOUND_HEAD)) || !(win[0] & KPF(KPF_THP))) return 0;
+    for (uint64_t i = 1; i < NR_PFN_2M; i++)
+        if (!(win[i] & KPF(KPF_COMPOUND_TAIL))) return 0;
+    return 1;
+}
+
+static uint64_t hugetlb_size(uint64_t pfn) {
+    uint64_t e[2];
+    uint64_t base = pfn & ~(NR_PFN_1G - 1);
+    if (read_u64s(kpageflags_fd, base, &e[0], 1) == 0 &&
+        read_u64s(kpageflags_fd, base + NR_PFN_2M, &e[1], 1) == 0 &&
+        (e[0] & KPF(KPF_COMPOUND_HEAD)) && (e[0] & KPF(KPF_HUGE)) &&
+        (e[1] & KPF(KPF_COMPOUND_TAIL)))
+        return NR_PFN_1G;
+    return NR_PFN_2M;
+}
+
+int page_info_lookup(struct page_flags_cache *pc, uint32_t pid, uint64_t vaddr,
+                     uint64_t phys_addr, struct page_info *out) {
+    memset(out, 0, sizeof(*out));
+    uint64_t pfn = phys_addr >> PFN_4K_SHIFT;
+    int pm_file = 0;
+
+    /* with a sampled pfn KPF_ANON / KPF_MMAP already say anon or file */
+    if (!pfn && vaddr && vaddr < USER_VA_END && pid) {
+        uint64_t pme;
+        if (read_pme(pc, pid, vaddr, &pme) == 0 && (pme & PM_PRESENT)) {
+            pm_file = (pme & PM_FILE) != 0;
+            pfn = pme & PM_PFN_MASK;
+        }
+    }
+    if (!pfn || kpageflags_fd < 0) return -1;
+    out->pfn = pfn;
+
+    uint64_t kpf;
+    if (read_u64s(kpageflags_fd, pfn, &kpf, 1) < 0) return -1;
+    out->flags = to_pgf(kpf);
+    if (pm_file && !(out->flags & PGF_ANON)) out->flags |= PGF_FILE;
+
+    /* same huge page as the previous sample and not split since: skip the scan */
+    if ((kpf & (KPF(KPF_THP) | KPF(KPF_HUGE))) && pc->huge_nr_pfn &&
+        pfn - pc->huge_base_pfn < pc->huge_nr_pfn) {
+        out->page_size = pc->huge_nr_pfn << PFN_4K_SHIFT;
+        return 0;
+    }
+
+    uint64_t nr_pfn = 1;
+    if (kpf & KPF(KPF_HUGE))
+        nr_pfn = hugetlb_size(pfn);
+    else if ((kpf & KPF(KPF_THP)) && is_pmd_thp(pfn))
+        nr_pfn = NR_PFN_2M;
+
+    if (nr_pfn > 1) {
+        pc->huge_base_pfn = pfn & ~(nr_pfn - 1);
+        pc->huge_nr_pfn = nr_pfn;
+    }
+    out->page_size = nr_pfn << PFN_4K_SHIFT;
+    return 0;
+}
+
+void page_flags_str(uint32_t flags, char *buf, size_t buf_size) {
+    static const struct {
+        uint32_t bit;
+        const char *name;
+    } names[] = {
+        {PGF_THP, "thp"},     {PGF_HUGETLB, "hugetlb"}, {PGF_ANON, "anon"},
+        {PGF_FILE, "file"},   {PGF_DIRTY, "dirty"},     {PGF_LRU, "lru"},
+    };
+    int n = 0;
+    buf[0] = '\0';
+    for (size_t i = 0; i < sizeof(names) / sizeof(names[0]); i++) {
+        if (!(flags & names[i].bit)) continue;
+        n += snprintf(buf + n, buf_size - n, "%s%s", n ? "|" : "", names[i].name);
+        if ((size_t)n >= buf_size) break;
+    }
+    if (n == 0) snprintf(buf, buf_size, "-");
+}
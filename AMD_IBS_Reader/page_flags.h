@@ -0,0 +1,40 @@
+#ifndef PAGE_FLAGS_H
+#define PAGE_FLAGS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* enrichment flags reported next to each sample */
+#define PGF_THP     (1u << 0)
+#define PGF_HUGETLB (1u << 1)
+#define PGF_ANON    (1u << 2)
+#define PGF_FILE    (1u << 3)
+#define PGF_DIRTY   (1u << 4)
+#define PGF_LRU     (1u << 5)
+
+#define PAGEMAP_FD_CACHE 16
+
+struct page_info {
+    uint64_t pfn;       /* 0 when unresolved */
+    uint64_t page_size; /* real mapping size: 4K, 2M or 1G, 0 when unresolved */
+    uint32_t flags;     /* PGF_* */
+};
+
+/* per reader thread: pagemap fds and the last huge page seen */
+struct page_flags_cache {
+    uint32_t pid[PAGEMAP_FD_CACHE];
+    int fd[PAGEMAP_FD_CACHE];
+    int next;
+    uint64_t huge_base_pfn;
+    uint64_t huge_nr_pfn;
+};
+
+int page_flags_init(void);
+void page_flags_exit(void);
+void page_flags_cache_init(struct page_flags_cache *pc);
+void page_flags_cache_free(struct page_flags_cache *pc);
+int page_info_lookup(struct page_flags_cache *pc, uint32_t pid, uint64_t vaddr,
+                     uint64_t phys_addr, struct page_info *out);
+void page_flags_str(uint32_t flags, char *buf, size_t buf_size);
+
+#endif // PAGE_FLAGS_H
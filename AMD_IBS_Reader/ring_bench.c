@@ -0,0 +1,348 @@
+/*
+ * ring_bench.c  ——  synthetic perf ring stress test for the ibs_reader consumer
+ *
+ * Producer threads write PERF_RECORD_SAMPLE records with the exact ibs_reader
+ * sample_type layout into fake perf_event_mmap_page rings (kernel-style
+ * data_head publishing, records split across the ring end, PERF_RECORD_LOST
+ * when the ring is full). The real cpu_loop() from ibs_ring.c drains them.
+ * No PMU or root needed.
+ *
+ *   ./ring_bench -r 200000 -s 72 -d 5 -n 4 -m all
+ *
+ *   -r  records/s per ring (0 = as fast as possible)    default 100000
+ *   -s  record size in bytes, >= 72, multiple of 8       default 72
+ *   -d  seconds per output mode                          default 3
+ *   -n  rings (= reader threads)                         default 1
+ *   -p  data pages per ring, power of two                default RING_PAGES
+ *   -u  consumer poll interval in us                     default POLL_US
+ *   -m  csv | stats | all                                default all
+ *   -o  CSV output path for the csv mode                 default ring_bench.csv
+ *
+ * The csv mode re-reads its output and checks every row: ip carries the
+ * record sequence number and lin_addr = ip ^ ADDR_MAGIC, so a record torn by
+ * the wrap-around path shows up as corrupt or out of order.
+ */
+#define _GNU_SOURCE
+#include <getopt.h>
+#include <inttypes.h>
+#include <linux/perf_event.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "ibs_ring.h"
+
+#define SAMPLE_FIELDS 8 /* ip tid time addr id cpu data_src phys_addr */
+#define MIN_REC_SZ (sizeof(struct perf_event_header) + SAMPLE_FIELDS * 8)
+#define ADDR_MAGIC 0x00007f0000000000ULL
+
+/* data_src values seen on Zen: L1 load/store, L3 HitM, local RAM, remote RAM */
+static const uint64_t data_src_mix[] = {
+    0x229080142ULL, 0x229080144ULL, 0x629800842ULL, 0x1a49081042ULL, 0x3a49081042ULL,
+};
+
+struct producer {
+    struct perf_event_mmap_page *meta;
+    char *data;
+    size_t ring_sz;
+    int id;
+    uint64_t rate;
+    uint32_t rec_size;
+    double duration;
+
+    uint64_t produced;
+    uint64_t dropped;
+    uint64_t wrapped;
+};
+
+static void ring_write(struct producer *p, uint64_t head, const void *buf, size_t len) {
+    size_t off = head & (p->ring_sz - 1);
+    size_t first = len < p->ring_sz - off ? len : p->ring_sz - off;
+    memcpy(p->data + off, buf, first);
+    if (first < len) memcpy(p->data, (const char *)buf + first, len - first);
+}
+
+static uint64_t ring_free(struct producer *p, uint64_t head) {
+    uint64_t tail = __atomic_load_n(&p->meta->data_tail, __ATOMIC_ACQUIRE);
+    return p->ring_sz - (head - tail);
+}
+
+static void *producer_loop(void *arg) {
+    struct producer *p = arg;
+    uint64_t rec[65536 / 8] = {0};
+    struct perf_event_header *h = (struct perf_event_header *)rec;
+    uint64_t *f = (uint64_t *)(h + 1);
+    uint64_t lost_pending = 0, seq = 0, head = p->meta->data_head;
+
+    uint64_t start = mono_ns();
+    uint64_t end = start + (uint64_t)(p->duration * 1e9);
+    uint64_t interval = p->rate ? 1000000000ULL / p->rate : 0;
+    uint64_t next = start;
+
+    for (;;) {
+        uint64_t now = mono_ns();
+        if (now >= end) break;
+        if (interval && now < next) {
+            if (next - now > 50000) {
+                struct timespec ts = {0, (long)(next - now - 20000)};
+                nanosleep(&ts, NULL);
+            }
+            continue;
+        }
+        next += interval;
+
+        /* the kernel reports drops once space frees up again */
+        if (lost_pending) {
+            uint64_t lost[3];
+            struct perf_event_header *lh = (struct perf_event_header *)lost;
+            *lh = (struct perf_event_header){.type = PERF_RECORD_LOST, .size = sizeof(lost)};
+            lost[1] = p->id;
+            lost[2] = lost_pending;
+            if (ring_free(p, head) < sizeof(lost) + p->rec_size) {
+                lost_pending++;
+                p->dropped++;
+                continue;
+            }
+            ring_write(p, head, lost, sizeof(lost));
+            head += sizeof(lost);
+            lost_pending = 0;
+        }
+
+        if (ring_free(p, head) < p->rec_size) {
+            lost_pending++;
+            p->dropped++;
+            continue;
+        }
+
+        *h = (struct perf_event_header){.type = PERF_RECORD_SAMPLE, .size = p->rec_size};
+        f[0] = seq;                                         /* ip */
+        f[1] = ((uint64_t)(2000 + p->id) << 32) | (1000 + p->id); /* tid:pid */
+        f[2] = now;                                         /* time */
+        f[3] = seq ^ ADDR_MAGIC;                            /* addr */
+        f[4] = p->id;                                       /* id */
+        f[5] = p->id;                                       /* cpu */
+        f[6] = data_src_mix[seq % (sizeof(data_src_mix) / sizeof(data_src_mix[0]))];
+        f[7] = (seq & 0xfffff) << 12;                       /* phys_addr */
+
+        size_t off = head & (p->ring_sz - 1);
+        if (off + p->rec_size > p->ring_sz) p->wrapped++;
+        ring_write(p, head, rec, p->rec_size);
+        head += p->rec_size;
+        __atomic_store_n(&p->meta->data_head, head, __ATOMIC_RELEASE);
+        p->produced++;
+        seq++;
+    }
+
+    /* flush the last LOST record so produced + dropped adds up */
+    while (lost_pending) {
+        uint64_t lost[3];
+        struct perf_event_header *lh = (struct perf_event_header *)lost;
+        *lh = (struct perf_event_header){.type = PERF_RECORD_LOST, .size = sizeof(lost)};
+        lost[1] = p->id;
+        lost[2] = lost_pending;
+        if (ring_free(p, head) >= sizeof(lost)) {
+            ring_write(p, head, lost, sizeof(lost));
+            head += sizeof(lost);
+            __atomic_store_n(&p->meta->data_head, head, __ATOMIC_RELEASE);
+            lost_pending = 0;
+        } else {
+            usleep(100);
+        }
+    }
+    return NULL;
+}
+
+/* check csv rows written by cpu_loop: lin_addr == ip ^ ADDR_MAGIC, ip increasing per cpu */
+static void verify_csv(const char *path, int nring, uint64_t *rows, uint64_t *corrupt) {
+    *rows = *corrupt = 0;
+    FILE *f = fopen(path, "r");
+    if (!f) {
+        perror("reopen bench csv");
+        return;
+    }
+    int64_t *last = malloc(nring * sizeof(*last));
+    for (int i = 0; i < nring; i++) last[i] = -1;
+
+    char line[1024];
+    while (fgets(line, sizeof(line), f)) {
+        unsigned long long ts, ip, addr;
+        unsigned pid, tid, cpu;
+        if (sscanf(line, "%llu,%u,%u,%u,0x%llx,0x%llx", &ts, &pid, &tid, &cpu, &ip, &addr) != 6)
+            continue;
+        (*rows)++;
+        if (cpu >= (unsigned)nring || addr != (ip ^ ADDR_MAGIC) || (int64_t)ip <= last[cpu]) {
+            (*corrupt)++;
+            continue;
+        }
+        last[cpu] = ip;
+    }
+    free(last);
+    fclose(f);
+}
+
+static const char *mode_name[IBS_OUTPUT_NR] = {"csv", "stats"};
+
+static int run_mode(int mode, int nring, size_t ring_pages, unsigned poll_us,
+                    uint64_t rate, uint32_t rec_size, double duration, const char *csv_path,
+                    struct ibs_reader_cfg *cfg) {
+    const size_t pg = sysconf(_SC_PAGESIZE);
+    const size_t map_sz = (ring_pages + 1) * pg;
+    volatile int running = 1;
+    cfg->running = &running;
+    cfg->output = mode;
+
+    FILE *csv = NULL;
+    if (mode == IBS_OUTPUT_CSV) {
+        csv = fopen(csv_path, "w");
+        if (!csv) {
+            perror("fopen bench csv");
+            return -1;
+        }
+    }
+
+    struct producer *prod = calloc(nring, sizeof(*prod));
+    struct cpu_ctx *ctx = calloc(nring, sizeof(*ctx));
+    pthread_t *pth = calloc(nring, sizeof(*pth));
+    pthread_t *cth = calloc(nring, sizeof(*cth));
+
+    for (int i = 0; i < nring; i++) {
+        void *ring = mmap(NULL, map_sz, PROT_READ | PROT_WRITE,
+                          MAP_PRIVATE | MAP_ANONYMOUS | MAP_POPULATE, -1, 0);
+        if (ring == MAP_FAILED) {
+            perror("mmap ring");
+            return -1;
+        }
+        prod[i] = (struct producer){.meta = ring, .data = (char *)ring + pg,
+                                    .ring_sz = ring_pages * pg, .id = i, .rate = rate,
+                                    .rec_size = rec_size, .duration = duration};
+        /* cpu -1: readers stay unpinned so the producers get their own cores */
+        if (cpu_ctx_init(&ctx[i], cfg, -1, -1, ring, ring_pages, csv) < 0) {
+            perror("cpu_ctx_init");
+            return -1;
+        }
+        ctx[i].poll_us = poll_us;
+    }
+
+    uint64_t t0 = mono_ns();
+    for (int i = 0; i < nring; i++) {
+        pthread_create(&cth[i], NULL, cpu_loop, &ctx[i]);
+        pthread_create(&pth[i], NULL, producer_loop, &prod[i]);
+    }
+    for (int i = 0; i < nring; i++) pthread_join(pth[i], NULL);
+
+    /* let the consumers catch up, then stop them */
+    for (int i = 0; i < nring && running; i++)
+        while (running && __atomic_load_n(&prod[i].meta->data_tail, __ATOMIC_ACQUIRE) !=
+                              __atomic_load_n(&prod[i].meta->data_head, __ATOMIC_ACQUIRE))
+            usleep(1000);
+    uint64_t elapsed = mono_ns() - t0;
+    int consumer_failed = !running;
+    running = 0;
+    for (int i = 0; i < nring; i++) pthread_join(cth[i], NULL);
+
+    uint64_t produced = 0, dropped = 0, wrapped = 0, consumed = 0, lost = 0;
+    uint64_t polls = 0, lag_sum = 0, lag_max = 0;
+    for (int i = 0; i < nring; i++) {
+        produced += prod[i].produced;
+        dropped += prod[i].dropped;
+        wrapped += prod[i].wrapped;
+        consumed += ctx[i].samples;
+        lost += ctx[i].lost;
+        polls += ctx[i].polls;
+        lag_sum += ctx[i].lag_sum;
+        if (ctx[i].lag_max > lag_max) lag_max = ctx[i].lag_max;
+    }
+
+    uint64_t rows = 0, corrupt = 0;
+    if (csv) {
+        fclose(csv);
+        verify_csv(csv_path, nring, &rows, &corrupt);
+    }
+
+    double ring_sz = (double)ring_pages * pg;
+    double avg_lag = polls ? (double)lag_sum / polls : 0;
+    printf("%-6s produced %-10" PRIu64 " consumed %-10" PRIu64 " %10.0f rec/s"
+           "  overflow %-8" PRIu64 " lost(reported) %-8" PRIu64 " wrapped %-8" PRIu64 "\n",
+           mode_name[mode], produced, consumed, consumed / (elapsed / 1e9), dropped, lost,
+           wrapped);
+    printf("       lag avg %.0f B (%.1f%%) max %" PRIu64 " B (%.1f%%) over %" PRIu64 " polls",
+           avg_lag, 100.0 * avg_lag / ring_sz, lag_max, 100.0 * lag_max / ring_sz, polls);
+    if (mode == IBS_OUTPUT_CSV)
+        printf("  csv rows %" PRIu64 " corrupt %" PRIu64, rows, corrupt);
+    printf("\n");
+
+    int bad = consumer_failed || consumed != produced || lost != dropped ||
+              (mode == IBS_OUTPUT_CSV && (rows != consumed || corrupt));
+    if (bad) fprintf(stderr, "%s: consumer output does not match the producer\n", mode_name[mode]);
+
+    for (int i = 0; i < nring; i++) {
+        cpu_ctx_free(&ctx[i]);
+        munmap(prod[i].meta, map_sz);
+    }
+    free(prod);
+    free(ctx);
+    free(pth);
+    free(cth);
+    return bad ? -1 : 0;
+}
+
+int main(int argc, char **argv) {
+    uint64_t rate = 100000;
+    uint32_t rec_size = MIN_REC_SZ;
+    double duration = 3;
+    int nring = 1;
+    size_t ring_pages = RING_PAGES;
+    unsigned poll_us = POLL_US;
+    const char *mode = "all";
+    const char *csv_path = "ring_bench.csv";
+
+    int opt;
+    while ((opt = getopt(argc, argv, "r:s:d:n:p:u:m:o:h")) != -1) {
+        switch (opt) {
+        case 'r': rate = strtoull(optarg, NULL, 0); break;
+        case 's': rec_size = strtoul(optarg, NULL, 0); break;
+        case 'd': duration = atof(optarg); break;
+        case 'n': nring = atoi(optarg); break;
+        case 'p': ring_pages = strtoul(optarg, NULL, 0); break;
+        case 'u': poll_us = strtoul(optarg, NULL, 0); break;
+        case 'm': mode = optarg; break;
+        case 'o': csv_path = optarg; break;
+        default:
+            fprintf(stderr, "Usage: %s [-r rate] [-s rec_size] [-d sec] [-n rings] "
+                            "[-p ring_pages] [-u poll_us] [-m csv|stats|all] [-o csv]\n",
+                    argv[0]);
+            return 1;
+        }
+    }
+    if (rec_size < MIN_REC_SZ || rec_size % 8 || rec_size > 65528) {
+        fprintf(stderr, "record size must be >= %zu, <= 65528 and a multiple of 8\n", MIN_REC_SZ);
+        return 1;
+    }
+    if (!ring_pages || (ring_pages & (ring_pages - 1)) || nring < 1) {
+        fprintf(stderr, "ring pages must be a power of two and rings >= 1\n");
+        return 1;
+    }
+    if (rec_size > SCRATCH_SZ)
+        fprintf(stderr, "note: records > SCRATCH_SZ (%d) stop the consumer when they wrap\n",
+                SCRATCH_SZ);
+
+    struct ibs_reader_cfg cfg = {0};
+    if (numa_topology_load(&cfg.topo, nring) < 0) numa_topology_free(&cfg.topo);
+
+    printf("rings %d, %zu pages/ring, record %u B, rate %" PRIu64 "/s/ring%s, poll %u us, %.1f s\n",
+           nring, ring_pages, rec_size, rate, rate ? "" : " (max)", poll_us, duration);
+
+    int ret = 0;
+    for (int m = 0; m < IBS_OUTPUT_NR; m++) {
+        if (strcmp(mode, "all") && strcmp(mode, mode_name[m])) continue;
+        if (run_mode(m, nring, ring_pages, poll_us, rate, rec_size, duration, csv_path, &cfg) < 0)
+            ret = 1;
+    }
+
+    numa_topology_free(&cfg.topo);
+    return ret;
+}
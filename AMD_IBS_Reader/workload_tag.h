@@ -0,0 +1,220 @@
+#ifndef WORKLOAD_TAG_H
+#define WORKLOAD_TAG_H
+
+/*
+ * workload_tag.h  ——  shared-memory phase / key marker channel
+ *
+ * A workload (replay_trace) publishes what each of its threads is doing into
+ * a per-thread slot of a table in /dev/shm; ibs_reader looks up the sampled
+ * tid while draining the ring and writes the tag next to the sample.
+ *
+ * Writer side is a seqlock on a slot owned by a single thread: two plain
+ * stores of the sequence plus the payload, no syscalls and no shared cache
+ * lines between threads. Readers retry a few times and give up on a torn
+ * read. The tag is read when the sample is drained (a few ms after it was
+ * taken), so phase edges are accurate to the drain interval.
+ *
+ * Header only, usable from C and C++ (uses the GCC __atomic builtins).
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define WORKLOAD_TAG_SHM "/ibs_workload_tag"
+#define WORKLOAD_TAG_MAGIC 0x31474154574c4249ULL /* "IBLWTAG1" */
+#define WORKLOAD_TAG_SLOTS 1024 /* power of two */
+#define WORKLOAD_TAG_TOMBSTONE 0xffffffffU
+
+enum workload_phase {
+    WL_PHASE_NONE = 0,
+    WL_PHASE_OPEN,       /* DB::Open, table/manifest loading */
+    WL_PHASE_REPLAY,     /* measured trace lookups */
+    WL_PHASE_DONE,
+    WL_PHASE_COMPACTION, /* LevelDB background thread inside a scheduled job */
+};
+
+struct workload_tag {
+    uint32_t phase;
+    uint64_t op_index;
+    uint64_t key_id;
+};
+
+struct workload_tag_slot {
+    uint32_t tid;      /* 0 free, WORKLOAD_TAG_TOMBSTONE released */
+    uint32_t seq;      /* odd while the owner is writing */
+    uint32_t pid;
+    uint32_t phase;
+    uint64_t op_index;
+    uint64_t key_id;
+} __attribute__((aligned(64)));
+
+struct workload_tag_table {
+    uint64_t magic;
+    uint32_t nr_slots;
+    uint32_t reserved;
+    struct workload_tag_slot slots[WORKLOAD_TAG_SLOTS];
+};
+
+static inline const char *workload_phase_str(uint32_t phase) {
+    switch (phase) {
+    case WL_PHASE_OPEN:   return "open";
+    case WL_PHASE_REPLAY: return "replay";
+    case WL_PHASE_DONE:   return "done";
+    case WL_PHASE_COMPACTION: return "compaction";
+    default:              return "none";
+    }
+}
+
+/* FNV-1a 64 of the key bytes; offline tools hash trace keys the same way */
+static inline uint64_t workload_tag_key_id(const char *key, size_t len) {
+    uint64_t h = 0xcbf29ce484222325ULL;
+    for (size_t i = 0; i < len; i++) {
+        h ^= (unsigned char)key[i];
+        h *= 0x100000001b3ULL;
+    }
+    return h;
+}
+
+/* Map the table, creating it if needed so that the reader and the workload
+   can start in any order. Returns NULL on failure. */
+static inline struct workload_tag_table *workload_tag_attach(void) {
+    int fd = shm_open(WORKLOAD_TAG_SHM, O_RDWR | O_CREAT, 0666);
+    if (fd < 0) return NULL;
+    fchmod(fd, 0666); /* creator may be root, the workload usually is not */
+
+    struct stat st;
+    if (fstat(fd, &st) < 0 ||
+        ((size_t)st.st_size < sizeof(struct workload_tag_table) &&
+         ftruncate(fd, sizeof(struct workload_tag_table)) < 0)) {
+        close(fd);
+        return NULL;
+    }
+
+    void *p = mmap(NULL, sizeof(struct workload_tag_table),
+                   PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (p == MAP_FAILED) return NULL;
+
+    struct workload_tag_table *t = (struct workload_tag_table *)p;
+    uint64_t expect = 0;
+    __atomic_compare_exchange_n(&t->magic, &expect, WORKLOAD_TAG_MAGIC, 0,
+                                __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE);
+    if (__atomic_load_n(&t->magic, __ATOMIC_ACQUIRE) != WORKLOAD_TAG_MAGIC) {
+        munmap(p, sizeof(struct workload_tag_table));
+        return NULL;
+    }
+    t->nr_slots = WORKLOAD_TAG_SLOTS;
+    return t;
+}
+
+static inline void workload_tag_detach(struct workload_tag_table *t) {
+    if (t) munmap(t, sizeof(*t));
+}
+
+static inline uint32_t workload_tag_hash(uint32_t tid) {
+    return (tid * 2654435761U) & (WORKLOAD_TAG_SLOTS - 1);
+}
+
+/* a slot whose process is gone (killed before workload_tag_release) */
+static inline int workload_tag_owner_dead(const struct workload_tag_slot *s) {
+    uint32_t pid = __atomic_load_n(&s->pid, __ATOMIC_ACQUIRE);
+    return pid && kill((pid_t)pid, 0) < 0 && errno == ESRCH;
+}
+
+/* Claim the slot of the calling thread (done once per thread, off the hot
+   path). Reuses a slot left by an earlier thread with the same tid, a
+   released one, or one whose process has exited without releasing it. */
+static inline struct workload_tag_slot *
+workload_tag_claim(struct workload_tag_table *t, uint32_t pid, uint32_t tid) {
+    uint32_t h = workload_tag_hash(tid);
+
+    for (int attempt = 0; attempt < 8; attempt++) {
+        struct workload_tag_slot *grave = NULL, *found = NULL;
+        uint32_t grave_tid = 0;
+
+        for (uint32_t i = 0; i < WORKLOAD_TAG_SLOTS && !found; i++) {
+            struct workload_tag_slot *s =
+                &t->slots[(h + i) & (WORKLOAD_TAG_SLOTS - 1)];
+            uint32_t cur = __atomic_load_n(&s->tid, __ATOMIC_ACQUIRE);
+            if (cur == tid) {
+                found = s;
+            } else if (cur == WORKLOAD_TAG_TOMBSTONE) {
+                if (!grave) grave = s, grave_tid = cur;
+            } else if (cur == 0) {
+                if (grave) break; /* end of chain, reuse the tombstone */
+                if (__atomic_compare_exchange_n(&s->tid, &cur, tid, 0,
+                                                __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+                    found = s;
+            } else if (!grave && workload_tag_owner_dead(s)) {
+                grave = s, grave_tid = cur;
+            }
+        }
+
+        if (!found && grave) {
+            uint32_t cur = grave_tid;
+            if (__atomic_compare_exchange_n(&grave->tid, &cur, tid, 0,
+                                            __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+                found = grave;
+            else
+                continue; /* lost the slot to another thread */
+        }
+        if (found) __atomic_store_n(&found->pid, pid, __ATOMIC_RELEASE);
+        return found;
+    }
+    return NULL;
+}
+
+/* hot path: only the owning thread writes its slot */
+static inline void workload_tag_publish(struct workload_tag_slot *s,
+                                        uint32_t phase, uint64_t op_index,
+                                        uint64_t key_id) {
+    uint32_t seq = s->seq;
+    __atomic_store_n(&s->seq, seq + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    __atomic_store_n(&s->phase, phase, __ATOMIC_RELAXED);
+    __atomic_store_n(&s->op_index, op_index, __ATOMIC_RELAXED);
+    __atomic_store_n(&s->key_id, key_id, __ATOMIC_RELAXED);
+    __atomic_store_n(&s->seq, seq + 2, __ATOMIC_RELEASE);
+}
+
+static inline void workload_tag_release(struct workload_tag_slot *s) {
+    if (!s) return;
+    workload_tag_publish(s, WL_PHASE_DONE, s->op_index, s->key_id);
+    __atomic_store_n(&s->tid, WORKLOAD_TAG_TOMBSTONE, __ATOMIC_RELEASE);
+}
+
+/* Look up the tag of (pid, tid). Returns 0 and fills *out on success. */
+static inline int workload_tag_lookup(const struct workload_tag_table *t,
+                                      uint32_t pid, uint32_t tid,
+                                      struct workload_tag *out) {
+    uint32_t h = workload_tag_hash(tid);
+
+    for (uint32_t i = 0; i < WORKLOAD_TAG_SLOTS; i++) {
+        const struct workload_tag_slot *s =
+            &t->slots[(h + i) & (WORKLOAD_TAG_SLOTS - 1)];
+        uint32_t cur = __atomic_load_n(&s->tid, __ATOMIC_ACQUIRE);
+        if (cur == 0) return -1;
+        if (cur != tid || __atomic_load_n(&s->pid, __ATOMIC_ACQUIRE) != pid)
+            continue;
+
+        for (int retry = 0; retry < 4; retry++) {
+            uint32_t seq0 = __atomic_load_n(&s->seq, __ATOMIC_ACQUIRE);
+            if (seq0 & 1) continue;
+            out->phase = __atomic_load_n(&s->phase, __ATOMIC_RELAXED);
+            out->op_index = __atomic_load_n(&s->op_index, __ATOMIC_RELAXED);
+            out->key_id = __atomic_load_n(&s->key_id, __ATOMIC_RELAXED);
+            __atomic_thread_fence(__ATOMIC_ACQUIRE);
+            if (__atomic_load_n(&s->seq, __ATOMIC_RELAXED) == seq0) return 0;
+        }
+        return -1;
+    }
+    return -1;
+}
+
+#endif // WORKLOAD_TAG_H
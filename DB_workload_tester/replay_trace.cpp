@@ -4,12 +4,24 @@
 #include <fstream>
 #include <iomanip>
 #include <iostream>
+#include <atomic>
 #include <leveldb/db.h>
+#include <leveldb/env.h>
 #include <leveldb/options.h>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <signal.h>
 #include <sstream>
 #include <string>
+#include <thread>
+#include <sys/syscall.h>
+#include <unistd.h>
 #include <vector>
 
+#include "traced_env.h"
+#include "workload_tag.h"
+
 /* parse oracleGeneral format trace line */
 struct TraceEntry {
   std::string time;       /* timestamp */
@@ -30,6 +42,80 @@ TraceEntry parse_trace_line(const std::string &line) {
   return entry;
 }
 
+/* publish the current phase/op/key for ibs_reader; no-op without a table */
+static inline void tag_op(workload_tag_slot *slot, uint32_t phase,
+                          uint64_t op_index, uint64_t key_id) {
+  if (slot)
+    workload_tag_publish(slot, phase, op_index, key_id);
+}
+
+/*
+ * LevelDB compacts (and flushes the memtable) in jobs handed to
+ * Env::Schedule. Wrapping it gives each background thread its own tag slot
+ * that reads "compaction" while a job runs, so those samples are not lumped
+ * in with "none". The slots are not released: the background thread outlives
+ * the DB, and claim takes the slot back once the process is gone.
+ */
+class TaggedEnv : public leveldb::EnvWrapper {
+ public:
+  TaggedEnv(leveldb::Env *target, workload_tag_table *tags)
+      : leveldb::EnvWrapper(target), tags_(tags) {}
+
+  void Schedule(void (*fn)(void *), void *arg) override {
+    target()->Schedule(&TaggedEnv::Run, new job{this, fn, arg});
+  }
+  void StartThread(void (*fn)(void *), void *arg) override {
+    target()->StartThread(&TaggedEnv::Run, new job{this, fn, arg});
+  }
+
+ private:
+  struct job {
+    TaggedEnv *env;
+    void (*fn)(void *);
+    void *arg;
+  };
+
+  static void Run(void *p) {
+    job *j = static_cast<job *>(p);
+    workload_tag_slot *slot = j->env->ThreadSlot();
+    uint64_t n = j->env->jobs_.fetch_add(1, std::memory_order_relaxed);
+    tag_op(slot, WL_PHASE_COMPACTION, n, 0);
+    j->fn(j->arg);
+    tag_op(slot, WL_PHASE_NONE, n, 0);
+    delete j;
+  }
+
+  /* once per background thread, keyed by this env so nothing outlives it */
+  workload_tag_slot *ThreadSlot() {
+    std::lock_guard<std::mutex> lk(mu_);
+    auto it = slots_.find(std::this_thread::get_id());
+    if (it != slots_.end())
+      return it->second;
+    workload_tag_slot *slot = workload_tag_claim(tags_, getpid(), syscall(SYS_gettid));
+    slots_[std::this_thread::get_id()] = slot;
+    return slot;
+  }
+
+  workload_tag_table *tags_;
+  std::atomic<uint64_t> jobs_{0};
+  std::mutex mu_;
+  std::map<std::thread::id, workload_tag_slot *> slots_;
+};
+
+/* releases the tag slot on every way out of main, so slots do not pile up */
+struct tag_slot_guard {
+  workload_tag_table *tags = nullptr;
+  workload_tag_slot *slot = nullptr;
+  ~tag_slot_guard() {
+    workload_tag_release(slot);
+    workload_tag_detach(tags);
+  }
+};
+
+/* Ctrl-C ends the replay like the time limit does, so the report still runs */
+static volatile sig_atomic_t interrupted = 0;
+static void on_sigint(int) { interrupted = 1; }
+
 double percentile(std::vector<double> &data, double p) {
   assert(!data.empty());
   std::sort(data.begin(), data.end());
@@ -54,15 +140,43 @@ int main(int argc, char *argv[]) {
     if (max_duration_sec < 0)
       max_duration_sec = 0;
   }
+  /* phase/key marker slot read by ibs_reader, see workload_tag.h */
+  tag_slot_guard guard;
+  guard.tags = workload_tag_attach();
+  if (guard.tags)
+    guard.slot = workload_tag_claim(guard.tags, getpid(), syscall(SYS_gettid));
+  workload_tag_slot *slot = guard.slot;
+  if (!slot)
+    std::cerr << "Workload tags disabled (" << WORKLOAD_TAG_SHM
+              << " unavailable)\n";
+  tag_op(slot, WL_PHASE_OPEN, 0, 0);
+  signal(SIGINT, on_sigint);
+  signal(SIGTERM, on_sigint);
+
+  /* REPLAY_IO_TRACE=1 routes file reads through TracedEnv (traced_env.h) */
+  TracedEnv *io_env = nullptr;
+  if (getenv("REPLAY_IO_TRACE"))
+    io_env = new TracedEnv(leveldb::Env::Default(),
+                           io_probe_from_env(getenv("REPLAY_IO_PROBE")));
+
+  std::unique_ptr<TaggedEnv> tag_env;
+  if (guard.tags)
+    tag_env.reset(new TaggedEnv(io_env ? io_env : leveldb::Env::Default(), guard.tags));
 
   leveldb::DB *db;
   leveldb::Options options;
   options.create_if_missing = false; /* must already exist */
+  if (tag_env)
+    options.env = tag_env.get();
+  else if (io_env)
+    options.env = io_env;
   leveldb::Status status = leveldb::DB::Open(options, db_path, &db);
   if (!status.ok()) {
     std::cerr << "LevelDB open failed: " << status.ToString() << std::endl;
     return 2;
   }
+  /* closed before tag_env goes away: ~DB waits for the running compaction */
+  std::unique_ptr<leveldb::DB> db_owner(db);
 
   std::string size;
   if (db->GetProperty("leveldb.estimate-live-data-size", &size)) {
@@ -80,10 +194,11 @@ int main(int argc, char *argv[]) {
 
   std::vector<double> latencies;
   size_t total_ops = 0, success_ops = 0, notfound_ops = 0;
+  size_t op_index = 0;
   auto time_begin = std::chrono::steady_clock::now();
 
   std::string line;
-  while (std::getline(fin, line)) {
+  while (!interrupted && std::getline(fin, line)) {
     if (line.empty() || line[0] == '#')
       continue;
 
@@ -100,7 +215,12 @@ int main(int argc, char *argv[]) {
     }
 
     TraceEntry entry = parse_trace_line(line);
+    tag_op(slot, WL_PHASE_REPLAY, op_index,
+           workload_tag_key_id(entry.object.data(), entry.object.size()));
+    ++op_index;
 
+    if (io_env)
+      io_env->BeginLookup(op_index - 1);
     auto t0 = std::chrono::steady_clock::now();
     std::string value;
     leveldb::ReadOptions ro;
@@ -108,6 +228,10 @@ int main(int argc, char *argv[]) {
     leveldb::Status s = db->Get(ro, entry.object, &value);
     auto t1 = std::chrono::steady_clock::now();
     double latency = std::chrono::duration<double, std::milli>(t1 - t0).count();
+    if (io_env)
+      io_env->EndLookup(
+          std::chrono::duration_cast<std::chrono::nanoseconds>(t1 - t0).count(),
+          value.size());
 
     latencies.push_back(latency);
     ++total_ops;
@@ -119,8 +243,11 @@ int main(int argc, char *argv[]) {
       std::cerr << "Read failed: " << s.ToString() << std::endl;
   }
 
+  if (interrupted)
+    std::cout << "Interrupted, stopping replay.\n";
   auto time_end = std::chrono::steady_clock::now();
   double elapsed = std::chrono::duration<double>(time_end - time_begin).count();
+  tag_op(slot, WL_PHASE_DONE, op_index, 0);
 
   double throughput = (elapsed > 0) ? (total_ops / elapsed) : 0.0;
   double p99_latency = latencies.empty() ? 0.0 : percentile(latencies, 0.99);
@@ -133,6 +260,10 @@ int main(int argc, char *argv[]) {
   std::cout << "Throughput:     " << throughput << " ops/sec" << std::endl;
   std::cout << "p99 latency:    " << p99_latency << " ms" << std::endl;
 
-  delete db;
+  db_owner.reset();
+  if (io_env) {
+    io_env->Report("io_trace.csv", "io_heatmap.csv", 64 * 1024);
+    delete io_env;
+  }
   return 0;
 }
@@ -0,0 +1,484 @@
+#include "traced_env.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <sys/mman.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+/* table layout constants from leveldb/table/format.h */
+static const size_t kFooterSize = 48;
+static const size_t kBlockTrailerSize = 5;
+static const uint64_t kTableMagic = 0xdb4775248b80fb57ull;
+
+static const char *kind_names[IO_KIND_NR] = {"open", "footer", "index", "metaindex",
+                                             "filter", "data", "sequential"};
+
+static inline uint64_t now_ns() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+static bool get_varint64(const char **p, const char *limit, uint64_t *v) {
+  uint64_t result = 0;
+  for (uint32_t shift = 0; shift <= 63 && *p < limit; shift += 7) {
+    uint64_t byte = (unsigned char)*(*p)++;
+    result |= (byte & 127) << shift;
+    if (!(byte & 128)) {
+      *v = result;
+      return true;
+    }
+  }
+  return false;
+}
+
+static uint32_t decode_fixed32(const char *p) {
+  uint32_t v;
+  memcpy(&v, p, sizeof(v)); /* little endian, as leveldb writes it */
+  return v;
+}
+
+/* "000123.ldb" -> 123, "MANIFEST-000005" -> 5 */
+static uint64_t file_number(const std::string &fname) {
+  size_t slash = fname.rfind('/');
+  const char *p = fname.c_str() + (slash == std::string::npos ? 0 : slash + 1);
+  const char *dash = strchr(p, '-');
+  if (!isdigit((unsigned char)*p) && dash)
+    p = dash + 1;
+  return strtoull(p, nullptr, 10);
+}
+
+int io_probe_from_env(const char *name) {
+  if (!name)
+    return IO_PROBE_NONE;
+  if (!strcmp(name, "mincore"))
+    return IO_PROBE_MINCORE;
+  if (!strcmp(name, "nowait"))
+    return IO_PROBE_NOWAIT;
+  std::cerr << "Unknown io probe '" << name << "', use mincore or nowait\n";
+  return IO_PROBE_NONE;
+}
+
+/*
+ * The per-thread cache is keyed by a generation id rather than the env's
+ * address: a later TracedEnv allocated at a freed env's address must not pick
+ * up a buffer the old one already deleted.
+ */
+static std::atomic<uint64_t> env_generation(0);
+static thread_local io_thread_buf *tls_buf = nullptr;
+static thread_local uint64_t tls_gen = 0;
+
+io_thread_buf *TracedEnv::ThreadBuf() {
+  if (tls_gen != gen_) {
+    tls_buf = new io_thread_buf;
+    tls_gen = gen_;
+    std::lock_guard<std::mutex> lk(mu_);
+    bufs_.push_back(tls_buf);
+  }
+  return tls_buf;
+}
+
+static void record_io(TracedEnv *env, uint64_t file, uint8_t kind, uint64_t offset,
+                      uint64_t len, uint64_t latency_ns, int8_t resident) {
+  io_thread_buf *b = env->ThreadBuf();
+  io_record r;
+  r.lookup = b->lookup;
+  r.file = file;
+  r.offset = offset;
+  r.len = len;
+  r.latency_ns = latency_ns > UINT32_MAX ? UINT32_MAX : latency_ns;
+  r.kind = kind;
+  r.resident = resident;
+  b->io.push_back(r);
+}
+
+/*
+ * The table reader reads the footer first, then the index and metaindex
+ * blocks it names, then the filter named in the metaindex; remembering those
+ * offsets is enough to classify every later read. Table::Open runs on one
+ * thread before the table is shared, so the plain members are safe.
+ *
+ * PosixEnv serves most tables through mmap: Read() then only hands out a
+ * pointer and the page fault happens later while the block is parsed, so
+ * the residency probe is what shows a cache miss, not the latency.
+ */
+class TracedRandomAccessFile : public leveldb::RandomAccessFile {
+ public:
+  TracedRandomAccessFile(TracedEnv *env, leveldb::RandomAccessFile *target,
+                         const std::string &fname)
+      : env_(env), target_(target), number_(file_number(fname)) {
+    if (!env->GetFileSize(fname, &size_).ok())
+      size_ = 0;
+    if (env->probe() != IO_PROBE_NONE)
+      fd_ = open(fname.c_str(), O_RDONLY | O_CLOEXEC);
+  }
+
+  ~TracedRandomAccessFile() override {
+    if (fd_ >= 0)
+      close(fd_);
+    delete target_;
+  }
+
+  leveldb::Status Read(uint64_t offset, size_t n, leveldb::Slice *result,
+                       char *scratch) const override {
+    int8_t resident = probe(offset, n);
+    uint64_t t0 = now_ns();
+    leveldb::Status s = target_->Read(offset, n, result, scratch);
+    uint64_t lat = now_ns() - t0;
+
+    uint8_t kind = classify(offset, n);
+    if (s.ok() && kind == IO_FOOTER)
+      parse_footer(*result);
+    else if (s.ok() && kind == IO_META)
+      parse_metaindex(*result);
+    record_io(env_, number_, kind, offset, n, lat, resident);
+    return s;
+  }
+
+ private:
+  uint8_t classify(uint64_t offset, size_t n) const {
+    /* the footer is the last kFooterSize bytes, a data block can be that short too */
+    if (n == kFooterSize && size_ >= kFooterSize && offset == size_ - kFooterSize)
+      return IO_FOOTER;
+    if (offset == index_off_ && n == index_size_ + kBlockTrailerSize)
+      return IO_INDEX;
+    if (offset == meta_off_ && n == meta_size_ + kBlockTrailerSize)
+      return IO_META;
+    if (std::find(filter_off_.begin(), filter_off_.end(), offset) != filter_off_.end())
+      return IO_FILTER;
+    return IO_DATA;
+  }
+
+  void parse_footer(const leveldb::Slice &footer) const {
+    const char *p = footer.data(), *limit = p + footer.size();
+    uint64_t magic;
+    if (footer.size() != kFooterSize)
+      return;
+    memcpy(&magic, limit - 8, 8);
+    if (magic != kTableMagic)
+      return;
+    uint64_t meta_off, meta_size, index_off, index_size;
+    if (get_varint64(&p, limit, &meta_off) && get_varint64(&p, limit, &meta_size) &&
+        get_varint64(&p, limit, &index_off) && get_varint64(&p, limit, &index_size)) {
+      meta_off_ = meta_off;
+      meta_size_ = meta_size;
+      index_off_ = index_off;
+      index_size_ = index_size;
+    }
+  }
+
+  /* uncompressed metaindex only: "filter.<policy>" -> filter block handle */
+  void parse_metaindex(const leveldb::Slice &block) const {
+    if (block.size() < kBlockTrailerSize + 4)
+      return;
+    size_t size = block.size() - kBlockTrailerSize;
+    const char *data = block.data();
+    if (data[size] != 0) /* kNoCompression */
+      return;
+    uint32_t restarts = decode_fixed32(data + size - 4);
+    if ((uint64_t)(restarts + 1) * 4 > size)
+      return;
+    const char *p = data, *limit = data + size - (restarts + 1) * 4;
+    std::string key;
+    while (p < limit) {
+      uint64_t shared, non_shared, value_len, off, len;
+      if (!get_varint64(&p, limit, &shared) || !get_varint64(&p, limit, &non_shared) ||
+          !get_varint64(&p, limit, &value_len) || shared > key.size() ||
+          (uint64_t)(limit - p) < non_shared + value_len)
+        return;
+      key.resize(shared);
+      key.append(p, non_shared);
+      p += non_shared;
+      const char *v = p;
+      p += value_len;
+      if (!key.compare(0, 7, "filter.") && get_varint64(&v, p, &off) && get_varint64(&v, p, &len))
+        filter_off_.push_back(off);
+    }
+  }
+
+  int8_t probe(uint64_t offset, size_t n) const {
+    if (fd_ < 0 || !n)
+      return -1;
+    if (env_->probe() == IO_PROBE_MINCORE) {
+      /* map just the pages of this read, a whole-table mapping per open file
+         would double the address space PosixEnv already maps */
+      static const uint64_t pg = sysconf(_SC_PAGESIZE);
+      uint64_t start = offset & ~(pg - 1), end = std::min<uint64_t>(offset + n, size_);
+      if (end <= start)
+        return -1;
+      void *map = mmap(nullptr, end - start, PROT_READ, MAP_SHARED, fd_, start);
+      if (map == MAP_FAILED)
+        return -1;
+      static thread_local std::vector<unsigned char> vec;
+      vec.resize((end - start + pg - 1) / pg);
+      int rc = mincore(map, end - start, vec.data());
+      munmap(map, end - start);
+      if (rc < 0)
+        return -1;
+      for (unsigned char c : vec)
+        if (!(c & 1))
+          return 0;
+      return 1;
+    }
+    /* RWF_NOWAIT copies the data when it is cached and fails instead of blocking */
+    static thread_local std::vector<char> buf;
+    buf.resize(n);
+    struct iovec iov = {buf.data(), n};
+    ssize_t r = preadv2(fd_, &iov, 1, offset, RWF_NOWAIT);
+    if (r < 0)
+      return errno == EAGAIN ? 0 : -1;
+    return (uint64_t)r == n || offset + r >= size_ ? 1 : 0;
+  }
+
+  TracedEnv *env_;
+  leveldb::RandomAccessFile *target_;
+  uint64_t number_;
+  int fd_ = -1;
+  uint64_t size_ = 0;
+  mutable uint64_t meta_off_ = UINT64_MAX, meta_size_ = 0;
+  mutable uint64_t index_off_ = UINT64_MAX, index_size_ = 0;
+  mutable std::vector<uint64_t> filter_off_;
+};
+
+class TracedSequentialFile : public leveldb::SequentialFile {
+ public:
+  TracedSequentialFile(TracedEnv *env, leveldb::SequentialFile *target, const std::string &fname)
+      : env_(env), target_(target), number_(file_number(fname)) {}
+  ~TracedSequentialFile() override { delete target_; }
+
+  leveldb::Status Read(size_t n, leveldb::Slice *result, char *scratch) override {
+    uint64_t t0 = now_ns();
+    leveldb::Status s = target_->Read(n, result, scratch);
+    record_io(env_, number_, IO_SEQ, pos_, n, now_ns() - t0, -1);
+    if (s.ok())
+      pos_ += result->size();
+    return s;
+  }
+
+  leveldb::Status Skip(uint64_t n) override {
+    pos_ += n;
+    return target_->Skip(n);
+  }
+
+ private:
+  TracedEnv *env_;
+  leveldb::SequentialFile *target_;
+  uint64_t number_;
+  uint64_t pos_ = 0;
+};
+
+TracedEnv::TracedEnv(leveldb::Env *target, int probe)
+    : leveldb::EnvWrapper(target), probe_(probe), gen_(++env_generation) {}
+
+TracedEnv::~TracedEnv() {
+  for (io_thread_buf *b : bufs_)
+    delete b;
+}
+
+leveldb::Status TracedEnv::NewSequentialFile(const std::string &fname,
+                                             leveldb::SequentialFile **result) {
+  uint64_t t0 = now_ns();
+  leveldb::Status s = target()->NewSequentialFile(fname, result);
+  record_io(this, file_number(fname), IO_OPEN, 0, 0, now_ns() - t0, -1);
+  if (s.ok())
+    *result = new TracedSequentialFile(this, *result, fname);
+  return s;
+}
+
+leveldb::Status TracedEnv::NewRandomAccessFile(const std::string &fname,
+                                               leveldb::RandomAccessFile **result) {
+  uint64_t t0 = now_ns();
+  leveldb::Status s = target()->NewRandomAccessFile(fname, result);
+  record_io(this, file_number(fname), IO_OPEN, 0, 0, now_ns() - t0, -1);
+  if (s.ok())
+    *result = new TracedRandomAccessFile(this, *result, fname);
+  return s;
+}
+
+void TracedEnv::BeginLookup(uint64_t lookup) {
+  io_thread_buf *b = ThreadBuf();
+  b->lookup = lookup;
+  b->lookup_first_io = b->io.size();
+}
+
+void TracedEnv::EndLookup(uint64_t latency_ns, uint32_t value_size) {
+  io_thread_buf *b = ThreadBuf();
+  lookup_record l;
+  l.lookup = b->lookup;
+  l.latency_ns = latency_ns;
+  l.value_size = value_size;
+  l.first_io = b->lookup_first_io;
+  l.nr_io = b->io.size() - b->lookup_first_io;
+  b->lookups.push_back(l);
+  b->lookup = IO_NO_LOOKUP;
+}
+
+template <typename T> static T pick(std::vector<T> &v, double p) {
+  if (v.empty())
+    return T();
+  size_t idx = std::min(v.size() - 1, static_cast<size_t>(p * v.size()));
+  std::nth_element(v.begin(), v.begin() + idx, v.end());
+  return v[idx];
+}
+
+void TracedEnv::Report(const std::string &io_csv, const std::string &heatmap_csv,
+                       uint64_t heat_bucket) const {
+  std::lock_guard<std::mutex> lk(mu_);
+
+  struct kind_stat {
+    uint64_t reads = 0, bytes = 0, probed = 0, misses = 0;
+    std::vector<uint64_t> lat;
+  } kinds[IO_KIND_NR];
+  uint64_t bg_reads = 0, bg_bytes = 0;
+
+  /* per lookup: reads, bytes, amplification and what the slow ones hit */
+  struct lookup_sum {
+    uint64_t latency_ns, reads, bytes, value;
+    bool miss, open, index;
+  };
+  std::vector<lookup_sum> sums;
+
+  std::map<std::pair<uint64_t, uint64_t>, kind_stat> heat;
+
+  for (const io_thread_buf *b : bufs_) {
+    for (const io_record &r : b->io) {
+      kind_stat &k = kinds[r.kind];
+      k.reads++;
+      k.bytes += r.len;
+      k.lat.push_back(r.latency_ns);
+      if (r.resident >= 0) {
+        k.probed++;
+        k.misses += r.resident == 0;
+      }
+      if (r.lookup == IO_NO_LOOKUP && r.kind != IO_OPEN) {
+        bg_reads++;
+        bg_bytes += r.len;
+      }
+      if (r.kind != IO_OPEN && r.kind != IO_SEQ) {
+        kind_stat &h = heat[std::make_pair(r.file, r.offset / heat_bucket * heat_bucket)];
+        h.reads++;
+        h.bytes += r.len;
+        h.misses += r.resident == 0;
+      }
+    }
+    for (const lookup_record &l : b->lookups) {
+      lookup_sum s = {l.latency_ns, 0, 0, l.value_size, false, false, false};
+      for (uint32_t i = l.first_io; i < l.first_io + l.nr_io; i++) {
+        const io_record &r = b->io[i];
+        if (r.kind == IO_OPEN) {
+          s.open = true;
+          continue;
+        }
+        s.reads++;
+        s.bytes += r.len;
+        s.miss |= r.resident == 0;
+        s.index |= r.kind == IO_INDEX || r.kind == IO_META || r.kind == IO_FILTER ||
+                   r.kind == IO_FOOTER;
+      }
+      sums.push_back(s);
+    }
+  }
+
+  std::cout << std::fixed << std::setprecision(2);
+  std::cout << "\nI/O trace (probe: "
+            << (probe_ == IO_PROBE_MINCORE ? "mincore" : probe_ == IO_PROBE_NOWAIT ? "nowait" : "off")
+            << ")\n";
+  std::cout << std::left << std::setw(12) << "kind" << std::setw(12) << "reads" << std::setw(14)
+            << "bytes" << std::setw(12) << "avg_us" << std::setw(12) << "p99_us"
+            << "miss%\n";
+  for (int i = 0; i < IO_KIND_NR; i++) {
+    kind_stat &k = kinds[i];
+    if (!k.reads)
+      continue;
+    uint64_t sum = 0;
+    for (uint64_t v : k.lat)
+      sum += v;
+    std::cout << std::setw(12) << kind_names[i] << std::setw(12) << k.reads << std::setw(14)
+              << k.bytes << std::setw(12) << sum / 1e3 / k.reads << std::setw(12)
+              << pick(k.lat, 0.99) / 1e3;
+    if (k.probed)
+      std::cout << 100.0 * k.misses / k.probed;
+    else
+      std::cout << "-";
+    std::cout << "\n";
+  }
+  std::cout << "Background reads (compaction/recovery): " << bg_reads << " (" << bg_bytes << " bytes)\n";
+
+  if (!sums.empty()) {
+    std::vector<uint64_t> reads, lat;
+    uint64_t bytes = 0, value = 0, missed = 0;
+    for (const lookup_sum &s : sums) {
+      reads.push_back(s.reads);
+      lat.push_back(s.latency_ns);
+      bytes += s.bytes;
+      value += s.value;
+      missed += s.miss;
+    }
+    std::cout << "Lookups:        " << sums.size() << ", reads per lookup p50 "
+              << pick(reads, 0.5) << " p99 " << pick(reads, 0.99) << " max "
+              << pick(reads, 1.0) << "\n";
+    std::cout << "Bytes per lookup " << (double)bytes / sums.size() << ", amplification "
+              << (value ? (double)bytes / value : 0.0) << "x of value bytes\n";
+    if (probe_ != IO_PROBE_NONE)
+      std::cout << "Lookups with a page-cache miss: " << 100.0 * missed / sums.size() << "%\n";
+
+    /* what the slowest 1% had in common */
+    uint64_t slow_ns = pick(lat, 0.99);
+    uint64_t slow = 0, slow_miss = 0, slow_open = 0, slow_index = 0, slow_reads = 0;
+    for (const lookup_sum &s : sums) {
+      if (s.latency_ns < slow_ns)
+        continue;
+      slow++;
+      slow_miss += s.miss;
+      slow_open += s.open;
+      slow_index += s.index;
+      slow_reads += s.reads;
+    }
+    std::cout << "Slowest 1% (>= " << slow_ns / 1e6 << " ms, " << slow << " lookups): "
+              << "file open " << 100.0 * slow_open / slow << "%, table metadata read "
+              << 100.0 * slow_index / slow << "%";
+    if (probe_ != IO_PROBE_NONE)
+      std::cout << ", page-cache miss " << 100.0 * slow_miss / slow << "%";
+    std::cout << ", avg reads " << (double)slow_reads / slow << "\n";
+  }
+
+  if (!io_csv.empty()) {
+    FILE *f = fopen(io_csv.c_str(), "w");
+    if (f) {
+      fprintf(f, "thread,lookup,file,kind,offset,len,latency_ns,resident\n");
+      for (size_t t = 0; t < bufs_.size(); t++)
+        for (const io_record &r : bufs_[t]->io)
+          fprintf(f, "%zu,%lld,%llu,%s,%llu,%u,%u,%d\n", t,
+                  r.lookup == IO_NO_LOOKUP ? -1LL : (long long)r.lookup,
+                  (unsigned long long)r.file, kind_names[r.kind],
+                  (unsigned long long)r.offset, r.len, r.latency_ns, r.resident);
+      fclose(f);
+      std::cout << "Reads written into " << io_csv << "\n";
+    }
+  }
+
+  if (!heatmap_csv.empty()) {
+    FILE *f = fopen(heatmap_csv.c_str(), "w");
+    if (f) {
+      fprintf(f, "file,bucket_offset,reads,bytes,misses\n");
+      for (const auto &kv : heat)
+        fprintf(f, "%llu,%llu,%llu,%llu,%llu\n", (unsigned long long)kv.first.first,
+                (unsigned long long)kv.first.second, (unsigned long long)kv.second.reads,
+                (unsigned long long)kv.second.bytes, (unsigned long long)kv.second.misses);
+      fclose(f);
+      std::cout << "SST offset heatmap (" << heat_bucket / 1024 << " KiB buckets) written into "
+                << heatmap_csv << "\n";
+    }
+  }
+}
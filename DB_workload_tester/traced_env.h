@@ -0,0 +1,94 @@
+#ifndef TRACED_ENV_H
+#define TRACED_ENV_H
+
+#include <cstdint>
+#include <leveldb/env.h>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/*
+ * leveldb::Env wrapper that records every file read made through it:
+ * file number, offset, length, latency, which part of the table was read and,
+ * optionally, whether the range was already in the page cache.
+ *
+ * Reads are attributed to the lookup announced with BeginLookup()/EndLookup()
+ * on the same thread; compaction and recovery reads land in "background".
+ * Every thread appends to its own buffer, nothing is shared on the read path.
+ */
+
+enum io_kind : uint8_t {
+  IO_OPEN = 0,   /* NewRandomAccessFile / NewSequentialFile, len 0 */
+  IO_FOOTER,     /* last 48 bytes of a table */
+  IO_INDEX,      /* index block */
+  IO_META,       /* metaindex block */
+  IO_FILTER,     /* filter block named in the metaindex */
+  IO_DATA,       /* any other table read: data blocks */
+  IO_SEQ,        /* SequentialFile: log / MANIFEST / compaction input */
+  IO_KIND_NR,
+};
+
+enum io_probe {
+  IO_PROBE_NONE = 0,
+  IO_PROBE_MINCORE, /* mincore() on a PROT_READ mapping of the read's pages */
+  IO_PROBE_NOWAIT,  /* preadv2(RWF_NOWAIT): short read or EAGAIN = not cached */
+};
+
+#define IO_NO_LOOKUP UINT64_MAX
+
+struct io_record {
+  uint64_t lookup;    /* op index, IO_NO_LOOKUP for background reads */
+  uint64_t file;      /* table / log number from the file name */
+  uint64_t offset;
+  uint32_t len;
+  uint32_t latency_ns;
+  uint8_t kind;       /* io_kind */
+  int8_t resident;    /* 1 cached, 0 not cached, -1 not probed */
+};
+
+struct lookup_record {
+  uint64_t lookup;
+  uint64_t latency_ns; /* end-to-end Get */
+  uint32_t value_size;
+  uint32_t first_io;   /* index of the first io_record of this lookup */
+  uint32_t nr_io;
+};
+
+struct io_thread_buf {
+  std::vector<io_record> io;
+  std::vector<lookup_record> lookups;
+  uint64_t lookup = IO_NO_LOOKUP;
+  uint32_t lookup_first_io = 0;
+};
+
+class TracedEnv : public leveldb::EnvWrapper {
+ public:
+  TracedEnv(leveldb::Env *target, int probe);
+  ~TracedEnv() override;
+
+  leveldb::Status NewSequentialFile(const std::string &fname,
+                                    leveldb::SequentialFile **result) override;
+  leveldb::Status NewRandomAccessFile(const std::string &fname,
+                                      leveldb::RandomAccessFile **result) override;
+
+  /* bracket one Get on the calling thread */
+  void BeginLookup(uint64_t lookup);
+  void EndLookup(uint64_t latency_ns, uint32_t value_size);
+
+  /* summary on stdout; raw reads and the offset heatmap as CSV */
+  void Report(const std::string &io_csv, const std::string &heatmap_csv,
+              uint64_t heat_bucket) const;
+
+  io_thread_buf *ThreadBuf();
+  int probe() const { return probe_; }
+
+ private:
+  int probe_;
+  uint64_t gen_; /* ThreadBuf key, unique per env */
+  mutable std::mutex mu_;
+  std::vector<io_thread_buf *> bufs_;
+};
+
+int io_probe_from_env(const char *name);
+
+#endif // TRACED_ENV_H
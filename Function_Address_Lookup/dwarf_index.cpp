@@ -0,0 +1,346 @@
+/*
+ * dwarf_index.cpp  ——  persistent DWARF line / inline-frame index for vmlinux
+ *
+ *   ./dwarf_index build <vmlinux> <vmlinux.dwidx>      once per kernel build
+ *   ./dwarf_index query <vmlinux.dwidx> <addr|name>...  or '-' to read stdin
+ *
+ *   build walks every CU with libdw and keeps:
+ *     - the line table (address -> file:line),
+ *     - every DW_TAG_subprogram and DW_TAG_inlined_subroutine address range,
+ *       with its nesting parent and the call site of inlined copies,
+ *     - a name index over those ranges.
+ *   query mmaps the file and answers with binary searches only:
+ *     0xADDR  function + inline chain, innermost first, with source lines
+ *     name    every out-of-line range and every inlined copy of the function,
+ *             as absolute address and outer_function+offset (for kprobes)
+ *
+ *   Offsets are from the function's entry address, as kprobes count them.
+ *   A function GCC split into hot and .cold parts has no symbol+offset for
+ *   the .cold part; copies there get the absolute address only.
+ *
+ *   Addresses are link-time vmlinux addresses; -s <slide> (hex) on query
+ *   subtracts a KASLR slide from address queries and adds it to printed ones.
+ *   Needs elfutils (libdw-devel / libdw-dev); the format and the query side
+ *   are in dwarf_index.h / dwarf_index_view.cpp and do not.
+ */
+#include <dwarf.h>
+#include <elfutils/libdw.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "dwarf_index.h"
+
+class string_pool {
+ public:
+  string_pool() { blob_.push_back('\0'); } /* offset 0 is "" */
+  uint32_t add(const char *s) {
+    if (!s || !*s)
+      return 0;
+    auto it = ids_.find(s);
+    if (it != ids_.end())
+      return it->second;
+    uint32_t off = blob_.size();
+    blob_.append(s);
+    blob_.push_back('\0');
+    ids_.emplace(s, off);
+    return off;
+  }
+  const std::string &blob() const { return blob_; }
+
+ private:
+  std::string blob_;
+  std::unordered_map<std::string, uint32_t> ids_;
+};
+
+struct builder {
+  string_pool strings;
+  std::vector<idx_range> ranges;
+  std::vector<idx_line> lines;
+  std::vector<uint32_t> cu_files; /* file index of the current CU -> string */
+
+  void add_lines(Dwarf_Die *cu);
+  void load_cu_files(Dwarf_Die *cu);
+  void walk(Dwarf_Die *die, uint32_t depth);
+};
+
+void builder::add_lines(Dwarf_Die *cu) {
+  Dwarf_Lines *dl;
+  size_t n;
+  if (dwarf_getsrclines(cu, &dl, &n) != 0)
+    return;
+  for (size_t i = 0; i < n; i++) {
+    Dwarf_Line *l = dwarf_onesrcline(dl, i);
+    Dwarf_Addr addr;
+    int lineno = 0;
+    bool end = false;
+    if (!l || dwarf_lineaddr(l, &addr) != 0)
+      continue;
+    dwarf_lineno(l, &lineno);
+    dwarf_lineendsequence(l, &end);
+    if (!end && lineno <= 0)
+      continue;
+    lines.push_back({addr, end ? 0 : strings.add(dwarf_linesrc(l, nullptr, nullptr)),
+                     end ? 0u : (uint32_t)lineno});
+  }
+}
+
+void builder::load_cu_files(Dwarf_Die *cu) {
+  cu_files.clear();
+  Dwarf_Files *files;
+  size_t n;
+  if (dwarf_getsrcfiles(cu, &files, &n) != 0)
+    return;
+  for (size_t i = 0; i < n; i++)
+    cu_files.push_back(strings.add(dwarf_filesrc(files, i, nullptr, nullptr)));
+}
+
+static const char *die_name(Dwarf_Die *die) {
+  Dwarf_Attribute attr;
+  /* inlined copies and out-of-line bodies of declarations name the origin */
+  if (dwarf_attr_integrate(die, DW_AT_name, &attr))
+    return dwarf_formstring(&attr);
+  return nullptr;
+}
+
+void builder::walk(Dwarf_Die *die, uint32_t depth) {
+  Dwarf_Die child;
+  if (dwarf_child(die, &child) != 0)
+    return;
+  do {
+    int tag = dwarf_tag(&child);
+    uint32_t next_depth = depth;
+
+    if (tag == DW_TAG_subprogram || tag == DW_TAG_inlined_subroutine) {
+      idx_range r = {};
+      r.name = strings.add(die_name(&child));
+      r.depth = tag == DW_TAG_subprogram ? 0 : depth + 1;
+      r.parent = NO_PARENT;
+      if (tag == DW_TAG_inlined_subroutine) {
+        Dwarf_Attribute attr;
+        Dwarf_Word file = 0, line = 0;
+        if (dwarf_attr(&child, DW_AT_call_file, &attr) && dwarf_formudata(&attr, &file) == 0 &&
+            file < cu_files.size())
+          r.call_file = cu_files[file];
+        if (dwarf_attr(&child, DW_AT_call_line, &attr) && dwarf_formudata(&attr, &line) == 0)
+          r.call_line = line;
+      }
+
+      /* DW_AT_entry_pc or DW_AT_low_pc, else the first range, the hot part */
+      Dwarf_Addr entry = 0;
+      if (tag == DW_TAG_subprogram && dwarf_entrypc(&child, &entry) != 0)
+        entry = 0;
+
+      Dwarf_Addr base, lo, hi;
+      ptrdiff_t off = 0;
+      bool has_pc = false;
+      while ((off = dwarf_ranges(&child, off, &base, &lo, &hi)) > 0) {
+        if (lo >= hi || !lo)
+          continue;
+        if (tag == DW_TAG_subprogram && !entry)
+          entry = lo;
+        r.entry = entry;
+        r.lo = lo;
+        r.hi = hi;
+        ranges.push_back(r);
+        has_pc = true;
+      }
+      /* nested functions / abstract instances without code keep the depth */
+      if (has_pc)
+        next_depth = r.depth;
+    }
+
+    /* inlined copies also sit in lexical blocks and in other inlined copies */
+    if (tag == DW_TAG_subprogram || tag == DW_TAG_inlined_subroutine ||
+        tag == DW_TAG_lexical_block || tag == DW_TAG_namespace)
+      walk(&child, next_depth);
+  } while (dwarf_siblingof(&child, &child) == 0);
+}
+
+static void align8(FILE *f) {
+  static const char zero[8] = {};
+  long pos = ftell(f);
+  if (pos % 8)
+    fwrite(zero, 1, 8 - pos % 8, f);
+}
+
+static int cmd_build(const char *vmlinux, const char *out_path) {
+  int fd = open(vmlinux, O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    perror(vmlinux);
+    return 1;
+  }
+  Dwarf *dw = dwarf_begin(fd, DWARF_C_READ);
+  if (!dw) {
+    fprintf(stderr, "%s: %s\n", vmlinux, dwarf_errmsg(-1));
+    close(fd);
+    return 1;
+  }
+
+  auto t0 = std::chrono::steady_clock::now();
+  builder b;
+  Dwarf_CU *cu = nullptr;
+  Dwarf_Die cudie;
+  uint8_t unit_type;
+  size_t nr_cu = 0;
+  while (dwarf_get_units(dw, cu, &cu, nullptr, &unit_type, &cudie, nullptr) == 0) {
+    if (unit_type != DW_UT_compile && unit_type != DW_UT_partial)
+      continue;
+    b.add_lines(&cudie);
+    b.load_cu_files(&cudie);
+    b.walk(&cudie, 0);
+    nr_cu++;
+  }
+  dwarf_end(dw);
+  close(fd);
+
+  /* ranges: outer before inner at the same address, then nesting parents */
+  std::sort(b.ranges.begin(), b.ranges.end(), [](const idx_range &x, const idx_range &y) {
+    if (x.lo != y.lo)
+      return x.lo < y.lo;
+    if (x.hi != y.hi)
+      return x.hi > y.hi;
+    return x.depth < y.depth;
+  });
+  std::vector<uint32_t> stack;
+  for (uint32_t i = 0; i < b.ranges.size(); i++) {
+    idx_range &r = b.ranges[i];
+    while (!stack.empty() &&
+           !(b.ranges[stack.back()].lo <= r.lo && r.hi <= b.ranges[stack.back()].hi))
+      stack.pop_back();
+    if (r.depth && !stack.empty())
+      r.parent = stack.back();
+    stack.push_back(i);
+  }
+
+  /* lines: sequence ends first so a sequence starting at the same address wins */
+  std::stable_sort(b.lines.begin(), b.lines.end(), [](const idx_line &x, const idx_line &y) {
+    if (x.addr != y.addr)
+      return x.addr < y.addr;
+    return x.line == 0 && y.line != 0;
+  });
+  std::vector<idx_line> lines;
+  lines.reserve(b.lines.size());
+  for (const idx_line &l : b.lines) {
+    if (!lines.empty() && lines.back().addr == l.addr)
+      lines.back() = l;
+    else if (lines.empty() || lines.back().file != l.file || lines.back().line != l.line)
+      lines.push_back(l);
+  }
+
+  const std::string &blob = b.strings.blob();
+  std::vector<idx_name> names;
+  names.reserve(b.ranges.size());
+  for (uint32_t i = 0; i < b.ranges.size(); i++)
+    if (b.ranges[i].name)
+      names.push_back({b.ranges[i].name, i});
+  std::stable_sort(names.begin(), names.end(), [&blob](const idx_name &x, const idx_name &y) {
+    return strcmp(blob.c_str() + x.name, blob.c_str() + y.name) < 0;
+  });
+
+  FILE *f = fopen(out_path, "wb");
+  if (!f) {
+    perror(out_path);
+    return 1;
+  }
+  idx_hdr h = {};
+  memcpy(h.magic, IDX_MAGIC, 8);
+  h.version = IDX_VERSION;
+  h.nr_ranges = b.ranges.size();
+  h.nr_lines = lines.size();
+  h.nr_names = names.size();
+  h.strings_size = blob.size();
+  fwrite(&h, sizeof(h), 1, f);
+  align8(f);
+  h.off_ranges = ftell(f);
+  fwrite(b.ranges.data(), sizeof(idx_range), b.ranges.size(), f);
+  align8(f);
+  h.off_lines = ftell(f);
+  fwrite(lines.data(), sizeof(idx_line), lines.size(), f);
+  align8(f);
+  h.off_names = ftell(f);
+  fwrite(names.data(), sizeof(idx_name), names.size(), f);
+  align8(f);
+  h.off_strings = ftell(f);
+  fwrite(blob.data(), 1, blob.size(), f);
+  rewind(f);
+  fwrite(&h, sizeof(h), 1, f);
+  if (fclose(f) != 0) {
+    perror(out_path);
+    return 1;
+  }
+
+  double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+  printf("%zu CUs, %zu ranges, %zu line rows, %zu bytes of strings in %.1f s -> %s\n", nr_cu,
+         b.ranges.size(), lines.size(), blob.size(), secs, out_path);
+  return 0;
+}
+
+static void run_query(const index_view &idx, const std::string &q) {
+  if (q.empty())
+    return;
+  if (!q.compare(0, 2, "0x") || !q.compare(0, 2, "0X"))
+    idx.query_addr(strtoull(q.c_str(), nullptr, 16));
+  else
+    idx.query_name(q.c_str());
+}
+
+static int cmd_query(int argc, char **argv) {
+  uint64_t slide = 0;
+  int i = 0;
+  if (i + 1 < argc && !strcmp(argv[i], "-s")) {
+    slide = strtoull(argv[i + 1], nullptr, 16);
+    i += 2;
+  }
+  if (i >= argc) {
+    fprintf(stderr, "query needs an index file\n");
+    return 1;
+  }
+  index_view idx;
+  if (!idx.open(argv[i++]))
+    return 1;
+  idx.slide = slide;
+
+  auto t0 = std::chrono::steady_clock::now();
+  size_t n = 0;
+  for (; i < argc; i++) {
+    if (strcmp(argv[i], "-")) {
+      run_query(idx, argv[i]);
+      n++;
+      continue;
+    }
+    /* batch mode: one address or name per line */
+    std::string line;
+    while (std::getline(std::cin, line)) {
+      run_query(idx, line);
+      n++;
+    }
+  }
+  fflush(stdout);
+  double us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - t0).count();
+  if (n)
+    fprintf(stderr, "%zu queries, %.2f us per query\n", n, us / n);
+  return 0;
+}
+
+int main(int argc, char **argv) {
+  if (argc == 4 && !strcmp(argv[1], "build"))
+    return cmd_build(argv[2], argv[3]);
+  if (argc >= 3 && !strcmp(argv[1], "query"))
+    return cmd_query(argc - 2, argv + 2);
+
+  fprintf(stderr,
+          "Usage: %s build <vmlinux> <index>\n"
+          "       %s query [-s kaslr_slide] <index> <0xaddr|function|->...\n",
+          argv[0], argv[0]);
+  return 1;
+}
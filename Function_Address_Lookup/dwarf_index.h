@@ -0,0 +1,77 @@
+/*
+ * dwarf_index.h  ——  on-disk format of vmlinux.dwidx and its mmap'ed reader
+ *
+ *   dwarf_index.cpp writes the file (needs libdw), dwarf_index_view.cpp
+ *   reads it and does not.
+ */
+#ifndef DWARF_INDEX_H
+#define DWARF_INDEX_H
+
+#include <cstdint>
+#include <cstdio>
+
+#define IDX_MAGIC "DWIDX002"
+#define IDX_VERSION 2
+#define NO_PARENT UINT32_MAX
+
+/* on-disk layout: header, then each array 8-byte aligned at the given offset */
+struct idx_hdr {
+  char magic[8];
+  uint32_t version;
+  uint32_t pad;
+  uint64_t nr_ranges, nr_lines, nr_names, strings_size;
+  uint64_t off_ranges, off_lines, off_names, off_strings;
+};
+
+/* subprogram (depth 0) or inlined copy, sorted by lo, enclosing range first */
+struct idx_range {
+  uint64_t lo, hi;
+  uint64_t entry;     /* depth 0: the function's entry address, which may lie in another range */
+  uint32_t name;      /* offset into strings */
+  uint32_t parent;    /* enclosing range, NO_PARENT for out-of-line functions */
+  uint32_t call_file; /* inlined only: call site, offset into strings */
+  uint32_t call_line;
+  uint32_t depth;
+  uint32_t pad;
+};
+
+/* line table row, line 0 marks the end of a sequence */
+struct idx_line {
+  uint64_t addr;
+  uint32_t file;
+  uint32_t line;
+};
+
+/* ranges sorted by name, then address */
+struct idx_name {
+  uint32_t name;
+  uint32_t range;
+};
+
+class index_view {
+ public:
+  ~index_view();
+  bool open(const char *path);
+  void query_addr(uint64_t addr) const;
+  void query_name(const char *name) const;
+  uint64_t slide = 0;
+  FILE *out = stdout;
+
+ private:
+  bool check(const char *base, uint64_t size) const;
+  const char *str(uint32_t off) const { return off < hdr_->strings_size ? strings_ + off : "??"; }
+  const idx_line *line_of(uint64_t addr) const;
+  const idx_range *innermost(uint64_t addr) const;
+  const idx_range *outermost(const idx_range *r) const;
+  void print_site(const idx_range *top, uint64_t a) const;
+
+  void *map_ = nullptr;
+  uint64_t map_size_ = 0;
+  const idx_hdr *hdr_ = nullptr;
+  const idx_range *ranges_ = nullptr;
+  const idx_line *lines_ = nullptr;
+  const idx_name *names_ = nullptr;
+  const char *strings_ = nullptr;
+};
+
+#endif // DWARF_INDEX_H
@@ -0,0 +1,167 @@
+/*
+ * dwarf_index_test.cpp  ——  queries against a hand-made index
+ *
+ *   make test_dwarf_index
+ *
+ *   do_reclaim is split into a hot part at 0x1000 and a .cold part at 0x5000,
+ *   with inl_fn inlined into both. Copies in the hot part must resolve to
+ *   do_reclaim+off from the entry, the .cold copy to its absolute address
+ *   only. Truncated or inconsistent files must be refused by open().
+ */
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "dwarf_index.h"
+
+static const char strings[] = "\0do_reclaim\0inl_fn\0mm/vmscan.c";
+#define S_RECLAIM 1
+#define S_INL 12
+#define S_VMSCAN 19
+
+struct image {
+  idx_hdr h = {};
+  std::vector<idx_range> ranges;
+  std::vector<idx_line> lines;
+  std::vector<idx_name> names;
+  std::string blob{strings, sizeof(strings)};
+};
+
+static image make_image() {
+  image im;
+  memcpy(im.h.magic, IDX_MAGIC, 8);
+  im.h.version = IDX_VERSION;
+  /* lo, hi, entry, name, parent, call_file, call_line, depth */
+  im.ranges = {
+      {0x1000, 0x1100, 0x1000, S_RECLAIM, NO_PARENT, 0, 0, 0, 0},
+      {0x1040, 0x1060, 0, S_INL, 0, S_VMSCAN, 42, 1, 0},
+      {0x5000, 0x5040, 0x1000, S_RECLAIM, NO_PARENT, 0, 0, 0, 0},
+      {0x5010, 0x5020, 0, S_INL, 2, S_VMSCAN, 50, 1, 0},
+  };
+  im.lines = {{0x1000, S_VMSCAN, 10}, {0x1040, S_VMSCAN, 20}, {0x1100, 0, 0},
+              {0x5000, S_VMSCAN, 60}, {0x5040, 0, 0}};
+  im.names = {{S_RECLAIM, 0}, {S_RECLAIM, 2}, {S_INL, 1}, {S_INL, 3}};
+  return im;
+}
+
+/* same layout as cmd_build: header, then the arrays 8-byte aligned */
+static void write_image(const std::string &path, image im,
+                        std::function<void(idx_hdr &)> tweak = nullptr, size_t cut = 0) {
+  std::string out(sizeof(idx_hdr), '\0');
+  auto put = [&out](const void *p, size_t n) {
+    out.append((8 - out.size() % 8) % 8, '\0');
+    uint64_t off = out.size();
+    out.append((const char *)p, n);
+    return off;
+  };
+  im.h.nr_ranges = im.ranges.size();
+  im.h.nr_lines = im.lines.size();
+  im.h.nr_names = im.names.size();
+  im.h.strings_size = im.blob.size();
+  im.h.off_ranges = put(im.ranges.data(), im.ranges.size() * sizeof(idx_range));
+  im.h.off_lines = put(im.lines.data(), im.lines.size() * sizeof(idx_line));
+  im.h.off_names = put(im.names.data(), im.names.size() * sizeof(idx_name));
+  im.h.off_strings = put(im.blob.data(), im.blob.size());
+  if (tweak)
+    tweak(im.h);
+  memcpy(&out[0], &im.h, sizeof(im.h));
+  out.resize(out.size() - cut);
+
+  FILE *f = fopen(path.c_str(), "wb");
+  assert(f);
+  fwrite(out.data(), 1, out.size(), f);
+  fclose(f);
+}
+
+template <class F>
+static std::string capture(index_view &idx, F query) {
+  char *buf = nullptr;
+  size_t len = 0;
+  idx.out = open_memstream(&buf, &len);
+  assert(idx.out);
+  query();
+  fclose(idx.out);
+  std::string s(buf, len);
+  free(buf);
+  return s;
+}
+
+static bool opens(const std::string &path) {
+  index_view idx;
+  return idx.open(path.c_str());
+}
+
+int main() {
+  char dir[] = "/tmp/dwarf_index_testXXXXXX";
+  char *made = mkdtemp(dir);
+  assert(made);
+  std::string path = std::string(dir) + "/vmlinux.dwidx";
+
+  write_image(path, make_image());
+  {
+    index_view idx;
+    bool ok = idx.open(path.c_str());
+    assert(ok);
+    assert(capture(idx, [&] { idx.query_name("inl_fn"); }) ==
+           "inl_fn\tinlined\t0x1040-0x1060\tdo_reclaim+0x40\tmm/vmscan.c:42\n"
+           "inl_fn\tinlined\t0x5010-0x5020\t0x5010\tmm/vmscan.c:50\n");
+    assert(capture(idx, [&] { idx.query_name("do_reclaim"); }) ==
+           "do_reclaim\tout_of_line\t0x1000-0x1100\n"
+           "do_reclaim\tout_of_line\t0x5000-0x5040\n");
+    assert(capture(idx, [&] { idx.query_name("missing"); }) == "missing\tnot_found\n");
+    assert(capture(idx, [&] { idx.query_addr(0x1044); }) ==
+           "0x1044\t1\tinl_fn\tmm/vmscan.c:20\tinlined\n"
+           "0x1044\t0\tdo_reclaim\tmm/vmscan.c:42\tdo_reclaim+0x44\n");
+    assert(capture(idx, [&] { idx.query_addr(0x5014); }) ==
+           "0x5014\t1\tinl_fn\tmm/vmscan.c:60\tinlined\n"
+           "0x5014\t0\tdo_reclaim\tmm/vmscan.c:50\t0x5014\n");
+    assert(capture(idx, [&] { idx.query_addr(0x3000); }) == "0x3000\t0\t??\t??:0\n");
+
+    /* slid queries: offsets unchanged, absolute addresses slid back */
+    idx.slide = 0x200000;
+    assert(capture(idx, [&] { idx.query_addr(0x201044); }) ==
+           "0x201044\t1\tinl_fn\tmm/vmscan.c:20\tinlined\n"
+           "0x201044\t0\tdo_reclaim\tmm/vmscan.c:42\tdo_reclaim+0x44\n");
+    assert(capture(idx, [&] { idx.query_addr(0x205014); }) ==
+           "0x205014\t1\tinl_fn\tmm/vmscan.c:60\tinlined\n"
+           "0x205014\t0\tdo_reclaim\tmm/vmscan.c:50\t0x205014\n");
+  }
+
+  /* files open() must refuse */
+  assert(!opens(std::string(dir) + "/absent"));
+  write_image(path, make_image(), nullptr, 4); /* strings cut short */
+  assert(!opens(path));
+  /* would wrap off + n * size */
+  write_image(path, make_image(), [](idx_hdr &h) { h.nr_lines = 1ULL << 60; });
+  assert(!opens(path));
+  /* ranges running into the other arrays and past the end */
+  write_image(path, make_image(), [](idx_hdr &h) { h.nr_ranges = 400; });
+  assert(!opens(path));
+  write_image(path, make_image(), [](idx_hdr &h) { h.off_names += 4; });
+  assert(!opens(path));
+  image im = make_image();
+  im.ranges[1].parent = 3; /* parents come first */
+  write_image(path, im);
+  assert(!opens(path));
+  im = make_image();
+  im.names[0].range = 4;
+  write_image(path, im);
+  assert(!opens(path));
+  im = make_image();
+  im.blob.back() = 'x'; /* strings not NUL-terminated */
+  write_image(path, im);
+  assert(!opens(path));
+  write_image(path, make_image(), [](idx_hdr &h) { h.version = 1; });
+  assert(!opens(path));
+
+  unlink(path.c_str());
+  rmdir(dir);
+  printf("All tests passed!\n");
+  return 0;
+}
@@ -0,0 +1,185 @@
+/*
+ * dwarf_index_view.cpp  ——  queries against an mmap'ed vmlinux.dwidx
+ *
+ *   The file is checked once in open(): every array must lie inside it,
+ *   parents must point back to an earlier range and the string block must
+ *   end in a NUL, so a truncated or foreign file cannot send a query out of
+ *   the mapping.
+ */
+#include "dwarf_index.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cinttypes>
+#include <cstring>
+
+index_view::~index_view() {
+  if (map_)
+    munmap(map_, map_size_);
+}
+
+/* n elements of size at off, 8-byte aligned, inside a file of size bytes */
+static bool fits(uint64_t off, uint64_t n, uint64_t elem, uint64_t size) {
+  return off % 8 == 0 && off <= size && n <= (size - off) / elem;
+}
+
+bool index_view::check(const char *base, uint64_t size) const {
+  const idx_hdr *h = (const idx_hdr *)base;
+  if (memcmp(h->magic, IDX_MAGIC, 8) || h->version != IDX_VERSION)
+    return false;
+  if (!fits(h->off_ranges, h->nr_ranges, sizeof(idx_range), size) || h->nr_ranges > NO_PARENT ||
+      !fits(h->off_lines, h->nr_lines, sizeof(idx_line), size) ||
+      !fits(h->off_names, h->nr_names, sizeof(idx_name), size) ||
+      !fits(h->off_strings, h->strings_size, 1, size))
+    return false;
+  if (!h->strings_size || base[h->off_strings + h->strings_size - 1])
+    return false;
+  const idx_range *r = (const idx_range *)(base + h->off_ranges);
+  for (uint64_t i = 0; i < h->nr_ranges; i++)
+    if (r[i].parent != NO_PARENT && r[i].parent >= i)
+      return false;
+  const idx_name *n = (const idx_name *)(base + h->off_names);
+  for (uint64_t i = 0; i < h->nr_names; i++)
+    if (n[i].range >= h->nr_ranges)
+      return false;
+  return true;
+}
+
+bool index_view::open(const char *path) {
+  int fd = ::open(path, O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    perror(path);
+    return false;
+  }
+  struct stat st;
+  if (fstat(fd, &st) < 0) {
+    perror(path);
+    close(fd);
+    return false;
+  }
+  void *p = (size_t)st.st_size >= sizeof(idx_hdr)
+                ? mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0)
+                : MAP_FAILED;
+  close(fd);
+  if (p == MAP_FAILED) {
+    fprintf(stderr, "%s: cannot map index\n", path);
+    return false;
+  }
+  if (!check((const char *)p, st.st_size)) {
+    fprintf(stderr, "%s: not a version %d dwarf index, or truncated\n", path, IDX_VERSION);
+    munmap(p, st.st_size);
+    return false;
+  }
+  map_ = p;
+  map_size_ = st.st_size;
+  hdr_ = (const idx_hdr *)p;
+  const char *base = (const char *)p;
+  ranges_ = (const idx_range *)(base + hdr_->off_ranges);
+  lines_ = (const idx_line *)(base + hdr_->off_lines);
+  names_ = (const idx_name *)(base + hdr_->off_names);
+  strings_ = base + hdr_->off_strings;
+  return true;
+}
+
+const idx_line *index_view::line_of(uint64_t addr) const {
+  const idx_line *end = lines_ + hdr_->nr_lines;
+  const idx_line *it = std::upper_bound(lines_, end, addr,
+                                        [](uint64_t a, const idx_line &l) { return a < l.addr; });
+  if (it == lines_ || !(it - 1)->line)
+    return nullptr;
+  return it - 1;
+}
+
+/*
+ * The last range starting at or before addr is the innermost range holding it
+ * or a nested range that already ended; in the latter case one of its parents
+ * is the answer, ranges nest properly.
+ */
+const idx_range *index_view::innermost(uint64_t addr) const {
+  const idx_range *end = ranges_ + hdr_->nr_ranges;
+  const idx_range *it = std::upper_bound(ranges_, end, addr,
+                                         [](uint64_t a, const idx_range &r) { return a < r.lo; });
+  if (it == ranges_)
+    return nullptr;
+  for (const idx_range *r = it - 1; r;) {
+    if (addr < r->hi)
+      return r;
+    r = r->parent == NO_PARENT ? nullptr : ranges_ + r->parent;
+  }
+  /* a longer function may still cover addr when the candidate ended before it */
+  for (size_t i = it - ranges_, seen = 0; i-- > 0 && seen < 64; seen++)
+    if (!ranges_[i].depth && addr < ranges_[i].hi)
+      return ranges_ + i;
+  return nullptr;
+}
+
+const idx_range *index_view::outermost(const idx_range *r) const {
+  while (r->parent != NO_PARENT)
+    r = ranges_ + r->parent;
+  return r;
+}
+
+/* outer+off when a lies past the entry in the entry range, else the absolute address */
+void index_view::print_site(const idx_range *top, uint64_t a) const {
+  if (top->lo <= top->entry && top->entry < top->hi && a >= top->entry)
+    fprintf(out, "%s+0x%" PRIx64, str(top->name), a - top->entry);
+  else
+    fprintf(out, "0x%" PRIx64, a + slide);
+}
+
+/* one line per frame, innermost first: addr depth function file:line */
+void index_view::query_addr(uint64_t addr) const {
+  uint64_t a = addr - slide;
+  const idx_range *r = innermost(a);
+  const idx_line *l = line_of(a);
+  char loc[512];
+  if (l)
+    snprintf(loc, sizeof(loc), "%s:%u", str(l->file), l->line);
+  else
+    snprintf(loc, sizeof(loc), "??:0");
+
+  if (!r) {
+    fprintf(out, "0x%" PRIx64 "\t0\t??\t%s\n", addr, loc);
+    return;
+  }
+  const idx_range *top = outermost(r);
+  for (; r; r = r->parent == NO_PARENT ? nullptr : ranges_ + r->parent) {
+    if (r->depth)
+      fprintf(out, "0x%" PRIx64 "\t%u\t%s\t%s\tinlined\n", addr, r->depth, str(r->name), loc);
+    else {
+      fprintf(out, "0x%" PRIx64 "\t0\t%s\t%s\t", addr, str(r->name), loc);
+      print_site(top, a);
+      fprintf(out, "\n");
+    }
+    /* the caller's line is where this copy was inlined */
+    snprintf(loc, sizeof(loc), "%s:%u", r->call_file ? str(r->call_file) : "??", r->call_line);
+  }
+}
+
+/* name kind lo-hi [outer+off call_file:call_line] */
+void index_view::query_name(const char *name) const {
+  const idx_name *end = names_ + hdr_->nr_names;
+  const idx_name *it = std::lower_bound(names_, end, name, [this](const idx_name &n, const char *s) {
+    return strcmp(str(n.name), s) < 0;
+  });
+  if (it == end || strcmp(str(it->name), name)) {
+    fprintf(out, "%s\tnot_found\n", name);
+    return;
+  }
+  for (; it != end && !strcmp(str(it->name), name); it++) {
+    const idx_range *r = ranges_ + it->range;
+    if (!r->depth) {
+      fprintf(out, "%s\tout_of_line\t0x%" PRIx64 "-0x%" PRIx64 "\n", name, r->lo + slide,
+              r->hi + slide);
+      continue;
+    }
+    const idx_range *top = outermost(r);
+    fprintf(out, "%s\tinlined\t0x%" PRIx64 "-0x%" PRIx64 "\t", name, r->lo + slide, r->hi + slide);
+    print_site(top, r->lo);
+    fprintf(out, "\t%s:%u\n", r->call_file ? str(r->call_file) : "??", r->call_line);
+  }
+}
@@ -0,0 +1,579 @@
+/*
+ * ip_symbolizer.cpp  ——  batch ip -> function for ibs_samples.csv
+ *
+ *   ./ip_symbolizer [-j threads] [-m maps_dir] [-k kallsyms|vmlinux] [-n top]
+ *                   [-o ibs_functions.csv] <ibs_samples.csv>
+ *
+ *   Kernel ips are resolved with kallsyms (maps_dir/kallsyms, else
+ *   /proc/kallsyms) or a vmlinux ELF, shifted by the KASLR offset taken from
+ *   _stext when kallsyms is readable. User ips go through <maps_dir>/<pid>.maps
+ *   (saved by ibs_reader with IBS_MAPS_DIR=<dir>, where later copies are
+ *   appended and win over earlier lines they overlap), falling back to the
+ *   live /proc/<pid>/maps, and the .symtab/.dynsym of every mapped ELF object.
+ *   Objects are mmapped once and turned into sorted address-range indexes.
+ *
+ *   The CSV is mmapped and split into one chunk per thread; each thread
+ *   resolves its rows and counts samples, L3 misses and TLB misses per
+ *   function with data_src_decoder.c, then the counts are merged.
+ */
+#include <elf.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <cxxabi.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+extern "C" {
+#include "data_src_decoder.h"
+}
+#include "kaslr.h"
+
+#define KERNEL_START 0xffff800000000000ULL
+
+/* column indexes in ibs_samples.csv */
+#define COL_PID 1
+#define COL_IP 4
+#define COL_DATA_SRC 7
+
+struct sym {
+  uint64_t start, end; /* [start, end) in the object's address space */
+  uint32_t id;         /* index into g_names */
+  uint32_t rank;       /* leading '_' count, picks printf over _IO_printf */
+};
+
+static uint32_t name_rank(const char *name) {
+  uint32_t n = 0;
+  while (name[n] == '_')
+    n++;
+  return n;
+}
+
+/* every function name gets a global id so threads can count into flat maps */
+static std::mutex g_names_mu;
+static std::vector<std::string> g_names;
+static std::unordered_map<std::string, uint32_t> g_name_ids;
+
+static uint32_t name_id(const std::string &name) {
+  std::lock_guard<std::mutex> lk(g_names_mu);
+  auto it = g_name_ids.find(name);
+  if (it != g_name_ids.end())
+    return it->second;
+  uint32_t id = g_names.size();
+  g_names.push_back(name);
+  g_name_ids.emplace(name, id);
+  return id;
+}
+
+static std::string base_name(const std::string &path) {
+  size_t p = path.rfind('/');
+  return p == std::string::npos ? path : path.substr(p + 1);
+}
+
+/* sort, fill in missing sizes from the next symbol, drop aliases */
+static void finish_index(std::vector<sym> &syms) {
+  std::sort(syms.begin(), syms.end(), [](const sym &a, const sym &b) {
+    if (a.start != b.start)
+      return a.start < b.start;
+    return a.end != b.end ? a.end > b.end : a.rank < b.rank;
+  });
+  std::vector<sym> out;
+  out.reserve(syms.size());
+  for (size_t i = 0; i < syms.size(); i++) {
+    if (!out.empty() && out.back().start == syms[i].start)
+      continue;
+    out.push_back(syms[i]);
+  }
+  for (size_t i = 0; i < out.size(); i++) {
+    if (out[i].end <= out[i].start)
+      out[i].end = i + 1 < out.size() ? out[i + 1].start : out[i].start + 1;
+  }
+  syms.swap(out);
+}
+
+static const sym *find_sym(const std::vector<sym> &syms, uint64_t addr) {
+  auto it = std::upper_bound(syms.begin(), syms.end(), addr,
+                             [](uint64_t a, const sym &s) { return a < s.start; });
+  if (it == syms.begin())
+    return nullptr;
+  --it;
+  return addr < it->end ? &*it : nullptr;
+}
+
+/* an mmapped ELF64 object: function symbols and PT_LOAD segments */
+struct elf_object {
+  std::string path;
+  uint32_t label_id; /* basename, used as the "object" column */
+  std::vector<sym> syms;
+  struct segment {
+    uint64_t offset, vaddr, filesz;
+  };
+  std::vector<segment> loads;
+  uint64_t stext = 0; /* _stext from .symtab, a NOTYPE linker-script symbol */
+
+  /* file offset of a mapping + ip -> address in the ELF's own vaddr space */
+  uint64_t to_vaddr(uint64_t file_off) const {
+    for (const segment &s : loads)
+      if (file_off >= s.offset && file_off < s.offset + std::max<uint64_t>(s.filesz, 1))
+        return file_off - s.offset + s.vaddr;
+    return file_off;
+  }
+};
+
+static bool load_elf(elf_object &obj) {
+  int fd = open(obj.path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0)
+    return false;
+  struct stat st;
+  if (fstat(fd, &st) < 0 || (size_t)st.st_size < sizeof(Elf64_Ehdr)) {
+    close(fd);
+    return false;
+  }
+  size_t len = st.st_size;
+  const char *base = (const char *)mmap(nullptr, len, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (base == MAP_FAILED)
+    return false;
+
+  const Elf64_Ehdr *eh = (const Elf64_Ehdr *)base;
+  if (memcmp(eh->e_ident, ELFMAG, SELFMAG) || eh->e_ident[EI_CLASS] != ELFCLASS64 ||
+      eh->e_shoff + (uint64_t)eh->e_shnum * sizeof(Elf64_Shdr) > len ||
+      eh->e_phoff + (uint64_t)eh->e_phnum * sizeof(Elf64_Phdr) > len) {
+    munmap((void *)base, len);
+    return false;
+  }
+
+  const Elf64_Phdr *ph = (const Elf64_Phdr *)(base + eh->e_phoff);
+  for (int i = 0; i < eh->e_phnum; i++)
+    if (ph[i].p_type == PT_LOAD)
+      obj.loads.push_back({ph[i].p_offset, ph[i].p_vaddr, ph[i].p_filesz});
+
+  const Elf64_Shdr *sh = (const Elf64_Shdr *)(base + eh->e_shoff);
+  for (int i = 0; i < eh->e_shnum; i++) {
+    if (sh[i].sh_type != SHT_SYMTAB && sh[i].sh_type != SHT_DYNSYM)
+      continue;
+    if (sh[i].sh_link >= eh->e_shnum || sh[i].sh_offset + sh[i].sh_size > len)
+      continue;
+    const Elf64_Shdr &strs = sh[sh[i].sh_link];
+    if (strs.sh_offset + strs.sh_size > len)
+      continue;
+    const char *strtab = base + strs.sh_offset;
+    const Elf64_Sym *s = (const Elf64_Sym *)(base + sh[i].sh_offset);
+    size_t n = sh[i].sh_size / sizeof(Elf64_Sym);
+    for (size_t j = 0; j < n; j++) {
+      if (!s[j].st_value || s[j].st_shndx == SHN_UNDEF || s[j].st_name >= strs.sh_size)
+        continue;
+      const char *name = strtab + s[j].st_name;
+      if (ELF64_ST_TYPE(s[j].st_info) != STT_FUNC)
+        continue;
+      obj.syms.push_back({s[j].st_value, s[j].st_value + s[j].st_size, name_id(name),
+                          name_rank(name)});
+    }
+  }
+  obj.stext = elf_stext(base, len);
+  munmap((void *)base, len);
+  finish_index(obj.syms);
+  return true;
+}
+
+struct mapping {
+  uint64_t start, end, offset;
+  const elf_object *obj; /* nullptr: anonymous / unreadable */
+  uint32_t obj_id;       /* object column for samples in this mapping */
+  uint32_t unknown_id;   /* function column when no symbol covers the ip */
+};
+
+struct process {
+  std::vector<mapping> maps; /* executable mappings, sorted */
+};
+
+struct func_stat {
+  uint64_t samples = 0, l3_miss = 0, tlb_miss = 0;
+};
+
+/* (object, function), both ids into g_names */
+struct func_key {
+  uint32_t obj, name;
+  bool operator==(const func_key &o) const { return obj == o.obj && name == o.name; }
+};
+
+struct func_key_hash {
+  size_t operator()(const func_key &k) const {
+    return std::hash<uint64_t>()((uint64_t)k.obj << 32 | k.name);
+  }
+};
+
+class symbolizer {
+ public:
+  symbolizer(std::string maps_dir) : maps_dir_(std::move(maps_dir)) {}
+
+  bool load_kernel(const std::string &path);
+  const process *get_process(uint32_t pid);
+
+  std::vector<sym> kernel_syms;
+  uint32_t kernel_obj = 0, unknown_obj = 0, unknown_name = 0;
+
+ private:
+  const elf_object *get_object(const std::string &path);
+  bool load_kallsyms(const std::string &path);
+
+  std::string maps_dir_;
+  std::mutex mu_;
+  std::unordered_map<uint32_t, std::unique_ptr<process>> procs_;
+  std::unordered_map<std::string, std::unique_ptr<elf_object>> objs_;
+};
+
+bool symbolizer::load_kallsyms(const std::string &path) {
+  std::ifstream in(path);
+  if (!in)
+    return false;
+  std::string line;
+  char type, name[512];
+  uint64_t addr;
+  bool all_zero = true;
+  while (std::getline(in, line)) {
+    if (sscanf(line.c_str(), "%" SCNx64 " %c %511s", &addr, &type, name) != 3)
+      continue;
+    if (type != 't' && type != 'T' && type != 'w' && type != 'W')
+      continue;
+    all_zero &= addr == 0;
+    kernel_syms.push_back({addr, 0, name_id(name), name_rank(name)});
+  }
+  if (all_zero) {
+    fprintf(stderr, "%s: all addresses are 0, run as root\n", path.c_str());
+    kernel_syms.clear();
+    return false;
+  }
+  return true;
+}
+
+bool symbolizer::load_kernel(const std::string &path) {
+  std::string kallsyms = maps_dir_.empty() ? "/proc/kallsyms" : maps_dir_ + "/kallsyms";
+  if (!maps_dir_.empty() && access(kallsyms.c_str(), R_OK))
+    kallsyms = "/proc/kallsyms";
+
+  if (path.empty()) {
+    if (!load_kallsyms(kallsyms))
+      return false;
+    finish_index(kernel_syms);
+    return true;
+  }
+
+  char magic[SELFMAG] = {};
+  std::ifstream probe(path, std::ios::binary);
+  probe.read(magic, SELFMAG);
+  if (memcmp(magic, ELFMAG, SELFMAG)) {
+    if (!load_kallsyms(path))
+      return false;
+    finish_index(kernel_syms);
+    return true;
+  }
+
+  /* vmlinux: link-time addresses, shift by KASLR when kallsyms tells us _stext */
+  elf_object vmlinux;
+  vmlinux.path = path;
+  if (!load_elf(vmlinux)) {
+    fprintf(stderr, "%s: cannot read ELF symbols\n", path.c_str());
+    return false;
+  }
+  uint64_t link_stext = vmlinux.stext;
+  if (!link_stext)
+    fprintf(stderr, "%s: no _stext in .symtab, KASLR slide not applied\n", path.c_str());
+
+  std::ifstream ks(kallsyms);
+  uint64_t run_stext = kallsyms_stext(ks);
+  uint64_t slide = kaslr_slide(run_stext, link_stext);
+  if (!run_stext)
+    fprintf(stderr, "no _stext in %s, assuming KASLR is off\n", kallsyms.c_str());
+  for (sym s : vmlinux.syms) {
+    s.start += slide;
+    s.end += slide;
+    kernel_syms.push_back(s);
+  }
+  finish_index(kernel_syms);
+  return true;
+}
+
+const elf_object *symbolizer::get_object(const std::string &path) {
+  auto it = objs_.find(path);
+  if (it != objs_.end())
+    return it->second.get();
+
+  std::unique_ptr<elf_object> obj(new elf_object);
+  obj->path = path;
+  obj->label_id = name_id(base_name(path));
+  if (!load_elf(*obj))
+    obj.reset();
+  const elf_object *ret = obj.get();
+  objs_.emplace(path, std::move(obj));
+  return ret;
+}
+
+/* maps snapshot (or live maps) of pid, loaded once and shared by all threads */
+const process *symbolizer::get_process(uint32_t pid) {
+  std::lock_guard<std::mutex> lk(mu_);
+  auto it = procs_.find(pid);
+  if (it != procs_.end())
+    return it->second.get();
+
+  std::unique_ptr<process> p(new process);
+  std::string path = maps_dir_ + "/" + std::to_string(pid) + ".maps";
+  std::ifstream in;
+  if (!maps_dir_.empty())
+    in.open(path);
+  if (!in.is_open())
+    in.open("/proc/" + std::to_string(pid) + "/maps");
+
+  std::vector<mapping> all; /* file order */
+  std::string line;
+  while (std::getline(in, line)) {
+    uint64_t start, end, offset;
+    char perms[8];
+    int name_at = 0;
+    if (sscanf(line.c_str(), "%" SCNx64 "-%" SCNx64 " %7s %" SCNx64 " %*s %*u %n", &start, &end,
+               perms, &offset, &name_at) < 4 || !strchr(perms, 'x'))
+      continue;
+    std::string file = name_at ? line.substr(name_at) : "";
+    if (file.size() > 10 && !file.compare(file.size() - 10, 10, " (deleted)"))
+      file.resize(file.size() - 10);
+    mapping m{start, end, offset, nullptr, 0, 0};
+    if (!file.empty() && file[0] == '/')
+      m.obj = get_object(file);
+    m.obj_id = name_id(file.empty() ? "[anon]" : base_name(file));
+    m.unknown_id = name_id("[unknown]");
+    all.push_back(m);
+  }
+
+  /* ibs_reader appends a fresh copy when the maps change: later lines win */
+  std::map<uint64_t, uint64_t> kept; /* start -> end, disjoint */
+  for (auto it = all.rbegin(); it != all.rend(); ++it) {
+    auto next = kept.lower_bound(it->end);
+    if (next != kept.begin() && std::prev(next)->second > it->start)
+      continue;
+    kept.emplace(it->start, it->end);
+    p->maps.push_back(*it);
+  }
+  std::sort(p->maps.begin(), p->maps.end(),
+            [](const mapping &a, const mapping &b) { return a.start < b.start; });
+
+  const process *ret = p.get();
+  procs_.emplace(pid, std::move(p));
+  return ret;
+}
+
+struct worker {
+  const char *begin, *end;
+  std::unordered_map<func_key, func_stat, func_key_hash> counts;
+  std::unordered_map<uint32_t, const process *> procs; /* thread-local cache */
+  uint64_t rows = 0, kernel = 0, resolved = 0;
+};
+
+static void resolve_chunk(symbolizer &sz, worker &w) {
+  const char *p = w.begin;
+  while (p < w.end) {
+    const char *eol = (const char *)memchr(p, '\n', w.end - p);
+    if (!eol)
+      eol = w.end;
+    if (eol == p) {
+      p++;
+      continue;
+    }
+
+    /* pid, ip and data_src columns */
+    const char *col = p;
+    uint64_t v[COL_DATA_SRC + 1] = {};
+    for (int c = 0; c <= COL_DATA_SRC && col < eol; c++) {
+      if (c == COL_PID || c == COL_IP || c == COL_DATA_SRC)
+        v[c] = strtoull(col, nullptr, 0);
+      col = (const char *)memchr(col, ',', eol - col);
+      if (!col)
+        break;
+      col++;
+    }
+    p = eol + 1;
+
+    uint32_t pid = v[COL_PID];
+    uint64_t ip = v[COL_IP], data_src = v[COL_DATA_SRC];
+    func_key key{sz.unknown_obj, sz.unknown_name};
+    w.rows++;
+
+    if (ip >= KERNEL_START) {
+      w.kernel++;
+      key.obj = sz.kernel_obj;
+      if (const sym *s = find_sym(sz.kernel_syms, ip)) {
+        key.name = s->id;
+        w.resolved++;
+      }
+    } else {
+      auto pit = w.procs.find(pid);
+      const process *proc = pit != w.procs.end() ? pit->second : (w.procs[pid] = sz.get_process(pid));
+      auto mit = std::upper_bound(proc->maps.begin(), proc->maps.end(), ip,
+                                  [](uint64_t a, const mapping &m) { return a < m.start; });
+      if (mit != proc->maps.begin() && ip < (--mit)->end) {
+        key.obj = mit->obj_id;
+        key.name = mit->unknown_id;
+        if (mit->obj) {
+          if (const sym *s = find_sym(mit->obj->syms, mit->obj->to_vaddr(ip - mit->start + mit->offset))) {
+            key.name = s->id;
+            w.resolved++;
+          }
+        }
+      }
+    }
+
+    func_stat &st = w.counts[key];
+    st.samples++;
+    st.l3_miss += is_llc_miss(data_src) != 0;
+    st.tlb_miss += is_tlb_miss(data_src) != 0;
+  }
+}
+
+static std::string demangle(const std::string &name) {
+  if (name.compare(0, 2, "_Z"))
+    return name;
+  int status = 0;
+  char *d = abi::__cxa_demangle(name.c_str(), nullptr, nullptr, &status);
+  std::string out = status == 0 && d ? d : name;
+  free(d);
+  return out;
+}
+
+int main(int argc, char **argv) {
+  int threads = std::max(1u, std::thread::hardware_concurrency());
+  std::string maps_dir, kernel_path, out_path = "ibs_functions.csv";
+  int top = 30, opt;
+  while ((opt = getopt(argc, argv, "j:m:k:n:o:")) != -1) {
+    switch (opt) {
+      case 'j': threads = std::max(1, atoi(optarg)); break;
+      case 'm': maps_dir = optarg; break;
+      case 'k': kernel_path = optarg; break;
+      case 'n': top = atoi(optarg); break;
+      case 'o': out_path = optarg; break;
+      default: optind = argc + 1; break;
+    }
+  }
+  if (optind + 1 != argc) {
+    fprintf(stderr,
+            "Usage: %s [-j threads] [-m maps_dir] [-k kallsyms|vmlinux] [-n top] "
+            "[-o ibs_functions.csv] <ibs_samples.csv>\n",
+            argv[0]);
+    return 1;
+  }
+
+  int fd = open(argv[optind], O_RDONLY | O_CLOEXEC);
+  struct stat st;
+  if (fd < 0 || fstat(fd, &st) < 0) {
+    perror(argv[optind]);
+    return 1;
+  }
+  size_t len = st.st_size;
+  const char *csv = len ? (const char *)mmap(nullptr, len, PROT_READ, MAP_PRIVATE, fd, 0) : nullptr;
+  close(fd);
+  if (!csv || csv == MAP_FAILED) {
+    fprintf(stderr, "%s: empty or unreadable\n", argv[optind]);
+    return 1;
+  }
+  madvise((void *)csv, len, MADV_SEQUENTIAL);
+
+  auto t0 = std::chrono::steady_clock::now();
+  symbolizer sz(maps_dir);
+  sz.kernel_obj = name_id("[kernel]");
+  sz.unknown_obj = name_id("[unknown]");
+  sz.unknown_name = sz.unknown_obj;
+  if (!sz.load_kernel(kernel_path))
+    fprintf(stderr, "kernel symbols unavailable, kernel ips stay [unknown]\n");
+
+  /* skip the header, then cut at line boundaries */
+  const char *body = (const char *)memchr(csv, '\n', len);
+  body = body ? body + 1 : csv + len;
+  const char *end = csv + len;
+  std::vector<worker> workers(threads);
+  const char *cur = body;
+  for (int i = 0; i < threads; i++) {
+    const char *cut = i == threads - 1 ? end : body + (end - body) * (i + 1) / threads;
+    if (cut < cur)
+      cut = cur;
+    while (cut < end && cut[-1] != '\n')
+      cut++;
+    workers[i].begin = cur;
+    workers[i].end = cut;
+    cur = cut;
+  }
+
+  auto t1 = std::chrono::steady_clock::now();
+  std::vector<std::thread> pool;
+  for (int i = 0; i < threads; i++)
+    pool.emplace_back(resolve_chunk, std::ref(sz), std::ref(workers[i]));
+  for (auto &t : pool)
+    t.join();
+  auto t2 = std::chrono::steady_clock::now();
+
+  std::unordered_map<func_key, func_stat, func_key_hash> total;
+  uint64_t rows = 0, kernel = 0, resolved = 0;
+  for (worker &w : workers) {
+    rows += w.rows;
+    kernel += w.kernel;
+    resolved += w.resolved;
+    for (auto &kv : w.counts) {
+      func_stat &t = total[kv.first];
+      t.samples += kv.second.samples;
+      t.l3_miss += kv.second.l3_miss;
+      t.tlb_miss += kv.second.tlb_miss;
+    }
+  }
+
+  std::vector<std::pair<func_key, func_stat>> rank(total.begin(), total.end());
+  std::sort(rank.begin(), rank.end(), [](const std::pair<func_key, func_stat> &a,
+                                         const std::pair<func_key, func_stat> &b) {
+    return a.second.samples > b.second.samples;
+  });
+
+  double load_s = std::chrono::duration<double>(t1 - t0).count();
+  double resolve_s = std::chrono::duration<double>(t2 - t1).count();
+  printf("%" PRIu64 " samples (%" PRIu64 " kernel), %.1f%% resolved, %zu functions\n", rows,
+         kernel, rows ? 100.0 * resolved / rows : 0.0, rank.size());
+  printf("kernel symbols %zu, load %.3f s, resolve %.3f s with %d threads (%.2f M samples/s)\n",
+         sz.kernel_syms.size(), load_s, resolve_s, threads,
+         resolve_s > 0 ? rows / resolve_s / 1e6 : 0.0);
+
+  printf("\n%-10s %-8s %-8s %-8s %-20s %s\n", "samples", "share%", "l3miss%", "tlbmiss%", "object",
+         "function");
+  for (int i = 0; i < top && i < (int)rank.size(); i++) {
+    const func_stat &s = rank[i].second;
+    printf("%-10" PRIu64 " %-8.2f %-8.2f %-8.2f %-20s %s\n", s.samples, 100.0 * s.samples / rows,
+           100.0 * s.l3_miss / s.samples, 100.0 * s.tlb_miss / s.samples,
+           g_names[rank[i].first.obj].c_str(), demangle(g_names[rank[i].first.name]).c_str());
+  }
+
+  FILE *out = fopen(out_path.c_str(), "w");
+  if (!out) {
+    perror(out_path.c_str());
+    return 1;
+  }
+  fprintf(out, "object,function,samples,l3_miss,tlb_miss\n");
+  for (auto &r : rank) {
+    std::string fn = demangle(g_names[r.first.name]);
+    std::replace(fn.begin(), fn.end(), ',', ';');
+    fprintf(out, "%s,%s,%" PRIu64 ",%" PRIu64 ",%" PRIu64 "\n", g_names[r.first.obj].c_str(),
+            fn.c_str(), r.second.samples, r.second.l3_miss, r.second.tlb_miss);
+  }
+  fclose(out);
+  printf("\nPer-function counts written into %s\n", out_path.c_str());
+  munmap((void *)csv, len);
+  return 0;
+}
@@ -0,0 +1,62 @@
+/*
+ * kaslr.h  ——  KASLR slide between a vmlinux and the running kernel
+ *
+ *   slide = _stext from kallsyms - _stext from the vmlinux .symtab
+ *
+ *   _stext is a NOTYPE symbol emitted by the linker script, so it has to be
+ *   looked up by name rather than among the STT_FUNC symbols.
+ */
+#ifndef KASLR_H
+#define KASLR_H
+
+#include <elf.h>
+
+#include <cinttypes>
+#include <cstdio>
+#include <cstring>
+#include <istream>
+#include <string>
+
+/* _stext of an ELF64 image in memory, 0 if it has none */
+static inline uint64_t elf_stext(const char *base, size_t len) {
+  if (len < sizeof(Elf64_Ehdr))
+    return 0;
+  const Elf64_Ehdr *eh = (const Elf64_Ehdr *)base;
+  if (memcmp(eh->e_ident, ELFMAG, SELFMAG) || eh->e_ident[EI_CLASS] != ELFCLASS64 ||
+      eh->e_shoff + (uint64_t)eh->e_shnum * sizeof(Elf64_Shdr) > len)
+    return 0;
+  const Elf64_Shdr *sh = (const Elf64_Shdr *)(base + eh->e_shoff);
+  for (int i = 0; i < eh->e_shnum; i++) {
+    if (sh[i].sh_type != SHT_SYMTAB || sh[i].sh_link >= eh->e_shnum ||
+        sh[i].sh_offset + sh[i].sh_size > len)
+      continue;
+    const Elf64_Shdr &strs = sh[sh[i].sh_link];
+    if (strs.sh_offset + strs.sh_size > len)
+      continue;
+    const Elf64_Sym *s = (const Elf64_Sym *)(base + sh[i].sh_offset);
+    for (size_t j = 0, n = sh[i].sh_size / sizeof(Elf64_Sym); j < n; j++)
+      if (s[j].st_value && s[j].st_shndx != SHN_UNDEF && s[j].st_name < strs.sh_size &&
+          !strcmp(base + strs.sh_offset + s[j].st_name, "_stext"))
+        return s[j].st_value;
+  }
+  return 0;
+}
+
+/* _stext of the running kernel from kallsyms text, 0 if absent or hidden */
+static inline uint64_t kallsyms_stext(std::istream &in) {
+  std::string line;
+  char type, name[512];
+  uint64_t addr;
+  while (std::getline(in, line))
+    if (sscanf(line.c_str(), "%" SCNx64 " %c %511s", &addr, &type, name) == 3 &&
+        !strcmp(name, "_stext"))
+      return addr;
+  return 0;
+}
+
+/* what to add to link-time addresses; 0 when either side is unknown */
+static inline uint64_t kaslr_slide(uint64_t run_stext, uint64_t link_stext) {
+  return run_stext && link_stext ? run_stext - link_stext : 0;
+}
+
+#endif // KASLR_H
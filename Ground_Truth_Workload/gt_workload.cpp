@@ -0,0 +1,583 @@
+/*
+ * gt_workload.cpp  ——  memory access workload with a known access distribution
+ *
+ *   ./gt_workload [-p pattern] [-t threads] [-s MiB] [-b backing] [-d seconds]
+ *                 [-n nodes] [-m memnodes] [-c cpus] [-w window_ms] [-o prefix] ...
+ *
+ *   Every thread allocates its own buffer (after pinning, so first touch and
+ *   mbind land on its node), prefaults it, waits for the others and then reads
+ *   8 bytes at a time in one of these patterns:
+ *
+ *     chase    pointer chase through every cache line in random cyclic order
+ *     stride   sequential walk with -S bytes between reads, wrapping at the end
+ *     uniform  uniformly random cache line
+ *     zipf     page rank drawn from Zipf(-z theta), ranks scattered over pages
+ *     shift    -q of the reads go to a hot set of -h of the pages, which moves
+ *              to the next pages every -I ms; the rest are uniform
+ *
+ *   Every read is counted per 4K page, so the counts are exact. Outputs:
+ *
+ *     <prefix>_counts.csv   window,start_ns,end_ns,tid,vaddr,count
+ *                           non-zero pages per -w window (default: whole run),
+ *                           times are CLOCK_MONOTONIC
+ *     <prefix>_pagemap.csv  pid,tid,vaddr,pfn,node,page_size
+ *                           every 4K page at the end of the run, pfn from
+ *                           /proc/self/pagemap (0 without CAP_SYS_ADMIN), node
+ *                           from move_pages. With -b thp page_size is per page
+ *                           from /proc/kpageflags as root, otherwise from the
+ *                           buffer's AnonHugePages in smaps (warns if partial)
+ *
+ *   score_hotness.py compares these with ibs_samples.csv.
+ *
+ *   -b 4k | thp | hugetlb | hugetlb1g     backing (default 4k)
+ *   -n 0,1     pin thread i to the cpus of node n[i % len] and bind its buffer there
+ *   -m 1       bind buffers to these nodes instead (remote access)
+ *   -c 2,4     pin thread i to cpu c[i % len] (overrides the cpus of -n)
+ *   -S bytes   stride (default 4160, one cache line past a page)
+ *   -z theta   zipf exponent (default 0.99)
+ *   -h frac    shift hot set size (default 0.05)
+ *   -q frac    shift hot set probability (default 0.9)
+ *   -I ms      shift interval (default 1000)
+ *   -r seed    random seed (default 1)
+ */
+#include <getopt.h>
+#include <fcntl.h>
+#include <linux/mempolicy.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cinttypes>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifndef MAP_HUGE_SHIFT
+#define MAP_HUGE_SHIFT 26
+#endif
+#ifndef MAP_HUGE_1GB
+#define MAP_HUGE_1GB (30 << MAP_HUGE_SHIFT)
+#endif
+
+#define PAGE_SHIFT 12
+#define PAGE_4K 4096ULL
+#define LINE 64ULL
+#define CHECK_EVERY 4096 /* reads between clock / stop checks */
+#define QUERY_BATCH 1024
+#define KPF_THP 22 /* include/uapi/linux/kernel-page-flags.h */
+
+enum pattern { PAT_CHASE, PAT_STRIDE, PAT_UNIFORM, PAT_ZIPF, PAT_SHIFT };
+enum backing { BACK_4K, BACK_THP, BACK_HUGETLB, BACK_HUGETLB_1G };
+
+static const char *pattern_names[] = {"chase", "stride", "uniform", "zipf", "shift"};
+static const char *backing_names[] = {"4k", "thp", "hugetlb", "hugetlb1g"};
+static const uint64_t backing_sizes[] = {PAGE_4K, 2ULL << 20, 2ULL << 20, 1ULL << 30};
+
+struct config {
+  int pattern = PAT_UNIFORM;
+  int backing = BACK_4K;
+  int threads = 1;
+  uint64_t bytes = 256ULL << 20;
+  double seconds = 10;
+  uint64_t window_ns = 0;
+  std::vector<int> nodes, memnodes, cpus;
+  uint64_t stride = PAGE_4K + LINE;
+  double theta = 0.99;
+  double hot_frac = 0.05, hot_prob = 0.9;
+  uint64_t shift_ns = 1000000000ULL;
+  uint64_t seed = 1;
+  std::string prefix = "gt";
+};
+
+struct count_rec {
+  uint32_t window;
+  uint32_t page;
+  uint64_t count;
+};
+
+struct worker {
+  int id = 0, cpu = -1, node = -1, memnode = -1;
+  pid_t tid = 0;
+  char *buf = nullptr;
+  uint64_t len = 0, npages = 0;
+  std::vector<uint64_t> counts;  /* current window, per 4K page */
+  std::vector<count_rec> out;    /* flushed windows */
+  uint64_t reads = 0;
+  uint64_t sink = 0;
+  bool ok = false;
+};
+
+static config cfg;
+static std::atomic<int> ready(0);
+static std::atomic<bool> go(false), stop(false);
+static uint64_t start_ns, end_ns;
+static std::vector<double> zipf_cdf;
+
+static uint64_t now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static inline uint64_t xorshift(uint64_t &s) {
+  s ^= s >> 12;
+  s ^= s << 25;
+  s ^= s >> 27;
+  return s * 2685821657736338717ULL;
+}
+
+static std::vector<int> parse_list(const char *s) {
+  std::vector<int> v;
+  for (const char *p = s; *p;) {
+    v.push_back(atoi(p));
+    p = strchr(p, ',');
+    if (!p)
+      break;
+    p++;
+  }
+  return v;
+}
+
+/* cpus of a node from sysfs, e.g. "0-7,16-23" */
+static std::vector<int> node_cpus(int node) {
+  std::vector<int> v;
+  char path[128], line[4096];
+  snprintf(path, sizeof(path), "/sys/devices/system/node/node%d/cpulist", node);
+  FILE *f = fopen(path, "r");
+  if (!f)
+    return v;
+  if (fgets(line, sizeof(line), f)) {
+    for (char *tok = strtok(line, ",\n"); tok; tok = strtok(nullptr, ",\n")) {
+      int a, b;
+      int n = sscanf(tok, "%d-%d", &a, &b);
+      if (n == 1)
+        b = a;
+      for (int c = a; n >= 1 && c <= b; c++)
+        v.push_back(c);
+    }
+  }
+  fclose(f);
+  return v;
+}
+
+static bool pin_self(worker &w) {
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  if (w.cpu >= 0) {
+    CPU_SET(w.cpu, &set);
+  } else if (w.node >= 0) {
+    std::vector<int> cpus = node_cpus(w.node);
+    if (cpus.empty()) {
+      fprintf(stderr, "thread %d: no cpus for node %d\n", w.id, w.node);
+      return false;
+    }
+    for (int c : cpus)
+      CPU_SET(c, &set);
+  } else {
+    return true;
+  }
+  if (sched_setaffinity(0, sizeof(set), &set) < 0) {
+    perror("sched_setaffinity");
+    return false;
+  }
+  return true;
+}
+
+static bool alloc_buffer(worker &w) {
+  uint64_t psize = backing_sizes[cfg.backing];
+  w.len = (cfg.bytes + psize - 1) / psize * psize;
+  w.npages = w.len >> PAGE_SHIFT;
+
+  int flags = MAP_PRIVATE | MAP_ANONYMOUS;
+  if (cfg.backing == BACK_HUGETLB)
+    flags |= MAP_HUGETLB;
+  else if (cfg.backing == BACK_HUGETLB_1G)
+    flags |= MAP_HUGETLB | MAP_HUGE_1GB;
+
+  /* THP needs a 2M aligned range, over-allocate and trim */
+  uint64_t map_len = cfg.backing == BACK_THP ? w.len + psize : w.len;
+  char *p = (char *)mmap(nullptr, map_len, PROT_READ | PROT_WRITE, flags, -1, 0);
+  if (p == MAP_FAILED) {
+    perror(cfg.backing >= BACK_HUGETLB ? "mmap hugetlb (check nr_hugepages)" : "mmap");
+    return false;
+  }
+  if (cfg.backing == BACK_THP) {
+    char *a = (char *)(((uintptr_t)p + psize - 1) & ~(psize - 1));
+    if (a > p)
+      munmap(p, a - p);
+    if (p + map_len > a + w.len)
+      munmap(a + w.len, p + map_len - (a + w.len));
+    p = a;
+  }
+  w.buf = p;
+
+  if (cfg.backing == BACK_THP && madvise(p, w.len, MADV_HUGEPAGE) < 0)
+    perror("madvise(MADV_HUGEPAGE)");
+  if (cfg.backing == BACK_4K && madvise(p, w.len, MADV_NOHUGEPAGE) < 0)
+    perror("madvise(MADV_NOHUGEPAGE)");
+
+  int bind = w.memnode >= 0 ? w.memnode : w.node;
+  if (bind >= 0) {
+    unsigned long mask[16] = {0};
+    mask[bind / 64] |= 1UL << (bind % 64);
+    if (syscall(SYS_mbind, p, w.len, MPOL_BIND, mask, sizeof(mask) * 8, 0) < 0) {
+      perror("mbind");
+      return false;
+    }
+  }
+  return true;
+}
+
+/* chase: one pointer per cache line, a single random cycle (Sattolo) */
+static void build_chase(worker &w, uint64_t &rng) {
+  uint64_t nlines = w.len / LINE;
+  std::vector<uint32_t> order(nlines);
+  for (uint64_t i = 0; i < nlines; i++)
+    order[i] = i;
+  for (uint64_t i = nlines - 1; i > 0; i--)
+    std::swap(order[i], order[xorshift(rng) % i]);
+  for (uint64_t i = 0; i < nlines; i++)
+    *(uint64_t *)(w.buf + order[i] * LINE) = order[(i + 1) % nlines] * LINE;
+}
+
+static void flush_window(worker &w, uint32_t win) {
+  for (uint64_t i = 0; i < w.npages; i++) {
+    if (w.counts[i]) {
+      w.out.push_back({win, (uint32_t)i, w.counts[i]});
+      w.counts[i] = 0;
+    }
+  }
+}
+
+static void run_worker(worker *wp) {
+  worker &w = *wp;
+  w.tid = syscall(SYS_gettid);
+  uint64_t rng = cfg.seed * 0x9E3779B97F4A7C15ULL + w.id + 1;
+
+  if (pin_self(w) && alloc_buffer(w)) {
+    if (cfg.pattern == PAT_CHASE)
+      build_chase(w, rng); /* writes every line, doubles as the prefault */
+    else
+      memset(w.buf, 1, w.len);
+    w.counts.assign(w.npages, 0);
+    w.ok = true;
+  }
+  ready++;
+  while (!go.load(std::memory_order_acquire))
+    std::this_thread::yield();
+  if (!w.ok)
+    return;
+
+  /* zipf rank -> page, scattered so hot pages are not neighbours */
+  std::vector<uint32_t> perm;
+  if (cfg.pattern == PAT_ZIPF) {
+    perm.resize(w.npages);
+    for (uint64_t i = 0; i < w.npages; i++)
+      perm[i] = i;
+    for (uint64_t i = w.npages - 1; i > 0; i--)
+      std::swap(perm[i], perm[xorshift(rng) % (i + 1)]);
+  }
+
+  const uint64_t nlines = w.len / LINE;
+  const uint64_t nhot = std::max<uint64_t>(1, w.npages * cfg.hot_frac);
+  const uint64_t stride = std::max<uint64_t>(8, cfg.stride & ~7ULL) % w.len;
+  uint64_t off = 0, hot_start = 0;
+  uint32_t win = 0;
+  uint64_t sink = 0;
+
+  while (!stop.load(std::memory_order_relaxed)) {
+    for (int i = 0; i < CHECK_EVERY; i++) {
+      switch (cfg.pattern) {
+        case PAT_CHASE:
+          break;
+        case PAT_STRIDE:
+          off += stride;
+          if (off >= w.len)
+            off -= w.len;
+          break;
+        case PAT_UNIFORM:
+          off = xorshift(rng) % nlines * LINE;
+          break;
+        case PAT_ZIPF: {
+          double u = (xorshift(rng) >> 11) * (1.0 / 9007199254740992.0);
+          uint64_t rank =
+              std::lower_bound(zipf_cdf.begin(), zipf_cdf.end(), u) - zipf_cdf.begin();
+          if (rank >= w.npages)
+            rank = w.npages - 1;
+          off = ((uint64_t)perm[rank] << PAGE_SHIFT) + xorshift(rng) % (PAGE_4K / LINE) * LINE;
+          break;
+        }
+        case PAT_SHIFT: {
+          double u = (xorshift(rng) >> 11) * (1.0 / 9007199254740992.0); /* [0, 1) */
+          uint64_t page = u < cfg.hot_prob ? (hot_start + xorshift(rng) % nhot) % w.npages
+                                           : xorshift(rng) % w.npages;
+          off = (page << PAGE_SHIFT) + xorshift(rng) % (PAGE_4K / LINE) * LINE;
+          break;
+        }
+      }
+      uint64_t v = *(volatile uint64_t *)(w.buf + off);
+      w.counts[off >> PAGE_SHIFT]++;
+      if (cfg.pattern == PAT_CHASE)
+        off = v;
+      sink += v;
+    }
+    w.reads += CHECK_EVERY;
+
+    uint64_t t = now_ns() - start_ns;
+    if (cfg.pattern == PAT_SHIFT)
+      hot_start = t / cfg.shift_ns * nhot % w.npages;
+    if (cfg.window_ns && t / cfg.window_ns > win) {
+      flush_window(w, win);
+      win = t / cfg.window_ns;
+    }
+  }
+  flush_window(w, win);
+  w.sink = sink;
+}
+
+static void build_zipf(uint64_t npages) {
+  zipf_cdf.resize(npages);
+  double sum = 0;
+  for (uint64_t i = 0; i < npages; i++) {
+    sum += 1.0 / pow((double)(i + 1), cfg.theta);
+    zipf_cdf[i] = sum;
+  }
+  for (double &c : zipf_cdf)
+    c /= sum;
+}
+
+static int write_counts(const std::vector<worker> &ws) {
+  std::string path = cfg.prefix + "_counts.csv";
+  FILE *f = fopen(path.c_str(), "w");
+  if (!f) {
+    perror(path.c_str());
+    return -1;
+  }
+  fprintf(f, "window,start_ns,end_ns,tid,vaddr,count\n");
+  for (const worker &w : ws) {
+    for (const count_rec &r : w.out) {
+      uint64_t ws_ns = start_ns + (uint64_t)r.window * cfg.window_ns;
+      uint64_t we_ns = cfg.window_ns ? std::min(end_ns, ws_ns + cfg.window_ns) : end_ns;
+      fprintf(f, "%u,%" PRIu64 ",%" PRIu64 ",%d,0x%" PRIx64 ",%" PRIu64 "\n", r.window, ws_ns,
+              we_ns, w.tid, (uint64_t)(uintptr_t)w.buf + ((uint64_t)r.page << PAGE_SHIFT),
+              r.count);
+    }
+  }
+  fclose(f);
+  printf("wrote %s\n", path.c_str());
+  return 0;
+}
+
+/* -b thp without /proc/kpageflags: 2M if smaps shows the buffer all THP, 4K if none */
+static uint64_t thp_buffer_size(const worker &w) {
+  const uint64_t huge = backing_sizes[BACK_THP];
+  FILE *f = fopen("/proc/self/smaps", "r");
+  if (!f)
+    return huge;
+  uintptr_t lo = (uintptr_t)w.buf, hi = lo + w.len;
+  uint64_t rss = 0, anon_huge = 0, kb;
+  unsigned long start, end;
+  bool in = false;
+  char line[512];
+  while (fgets(line, sizeof(line), f)) {
+    if (sscanf(line, "%lx-%lx ", &start, &end) == 2)
+      in = start < hi && end > lo;
+    else if (in && sscanf(line, "Rss: %" SCNu64 " kB", &kb) == 1)
+      rss += kb;
+    else if (in && sscanf(line, "AnonHugePages: %" SCNu64 " kB", &kb) == 1)
+      anon_huge += kb;
+  }
+  fclose(f);
+  if (!rss || anon_huge >= rss)
+    return huge;
+  if (!anon_huge)
+    return PAGE_4K;
+  fprintf(stderr,
+          "thread %d: only %.0f%% of the buffer is THP, page_size says 2M for all of it; "
+          "run as root for per-page sizes\n",
+          w.id, 100.0 * anon_huge / rss);
+  return huge;
+}
+
+/* KPF_THP and the pfn sits where a 2M folio mapped at the 2M aligned vaddr would */
+static uint64_t thp_page_size(int kpf, uint64_t vaddr, uint64_t pfn) {
+  const uint64_t huge = backing_sizes[BACK_THP];
+  uint64_t flags;
+  if (pread(kpf, &flags, sizeof(flags), pfn * sizeof(flags)) != sizeof(flags))
+    return 0;
+  uint64_t head = pfn - ((vaddr & (huge - 1)) >> PAGE_SHIFT);
+  return (flags >> KPF_THP & 1) && !(head & (huge / PAGE_4K - 1)) ? huge : PAGE_4K;
+}
+
+static int write_pagemap(const std::vector<worker> &ws) {
+  std::string path = cfg.prefix + "_pagemap.csv";
+  FILE *f = fopen(path.c_str(), "w");
+  if (!f) {
+    perror(path.c_str());
+    return -1;
+  }
+  int pm = open("/proc/self/pagemap", O_RDONLY);
+  if (pm < 0)
+    perror("open /proc/self/pagemap");
+  int kpf = cfg.backing == BACK_THP ? open("/proc/kpageflags", O_RDONLY) : -1;
+
+  fprintf(f, "pid,tid,vaddr,pfn,node,page_size\n");
+  bool any_pfn = false;
+  for (const worker &w : ws) {
+    uint64_t buf_size = 0; /* whole buffer guess, only read when a page needs it */
+    for (uint64_t i = 0; i < w.npages; i += QUERY_BATCH) {
+      uint64_t n = std::min<uint64_t>(QUERY_BATCH, w.npages - i);
+      uint64_t ent[QUERY_BATCH] = {0};
+      void *addrs[QUERY_BATCH];
+      int status[QUERY_BATCH];
+      for (uint64_t j = 0; j < n; j++) {
+        addrs[j] = w.buf + ((i + j) << PAGE_SHIFT);
+        status[j] = -1;
+      }
+      if (pm >= 0) {
+        off_t pos = ((uintptr_t)w.buf >> PAGE_SHIFT) + i;
+        if (pread(pm, ent, n * 8, pos * 8) < 0)
+          memset(ent, 0, sizeof(ent));
+      }
+      if (syscall(SYS_move_pages, 0, n, addrs, nullptr, status, 0) < 0)
+        for (uint64_t j = 0; j < n; j++)
+          status[j] = -1;
+
+      for (uint64_t j = 0; j < n; j++) {
+        /* bit 63 present, bits 0-54 pfn */
+        uint64_t pfn = (ent[j] >> 63) ? ent[j] & ((1ULL << 55) - 1) : 0;
+        uint64_t va = (uint64_t)(uintptr_t)addrs[j];
+        any_pfn |= pfn != 0;
+        uint64_t size = backing_sizes[cfg.backing];
+        if (cfg.backing == BACK_THP) {
+          size = kpf >= 0 && pfn ? thp_page_size(kpf, va, pfn) : 0;
+          if (!size)
+            size = buf_size ? buf_size : (buf_size = thp_buffer_size(w));
+        }
+        fprintf(f, "%d,%d,0x%" PRIx64 ",0x%" PRIx64 ",%d,%" PRIu64 "\n", (int)getpid(), w.tid, va,
+                pfn, status[j] >= 0 ? status[j] : -1, size);
+      }
+    }
+  }
+  if (pm >= 0)
+    close(pm);
+  if (kpf >= 0)
+    close(kpf);
+  fclose(f);
+  printf("wrote %s%s\n", path.c_str(), any_pfn ? "" : " (pfn 0: run as root to get frames)");
+  return 0;
+}
+
+static int parse_name(const char *s, const char *const *names, int n) {
+  for (int i = 0; i < n; i++)
+    if (!strcmp(s, names[i]))
+      return i;
+  return -1;
+}
+
+static void usage(const char *prog) {
+  fprintf(stderr,
+          "Usage: %s [-p chase|stride|uniform|zipf|shift] [-t threads] [-s MiB] [-d seconds]\n"
+          "       [-b 4k|thp|hugetlb|hugetlb1g] [-n nodes] [-m memnodes] [-c cpus] [-w window_ms]\n"
+          "       [-S stride] [-z theta] [-h hot_frac] [-q hot_prob] [-I shift_ms] [-r seed]\n"
+          "       [-o prefix]\n",
+          prog);
+}
+
+int main(int argc, char **argv) {
+  int opt;
+  while ((opt = getopt(argc, argv, "p:t:s:b:d:n:m:c:w:S:z:h:q:I:r:o:")) != -1) {
+    switch (opt) {
+      case 'p': cfg.pattern = parse_name(optarg, pattern_names, 5); break;
+      case 't': cfg.threads = atoi(optarg); break;
+      case 's': cfg.bytes = strtoull(optarg, nullptr, 10) << 20; break;
+      case 'b': cfg.backing = parse_name(optarg, backing_names, 4); break;
+      case 'd': cfg.seconds = atof(optarg); break;
+      case 'n': cfg.nodes = parse_list(optarg); break;
+      case 'm': cfg.memnodes = parse_list(optarg); break;
+      case 'c': cfg.cpus = parse_list(optarg); break;
+      case 'w': cfg.window_ns = strtoull(optarg, nullptr, 10) * 1000000ULL; break;
+      case 'S': cfg.stride = strtoull(optarg, nullptr, 10); break;
+      case 'z': cfg.theta = atof(optarg); break;
+      case 'h': cfg.hot_frac = atof(optarg); break;
+      case 'q': cfg.hot_prob = atof(optarg); break;
+      case 'I': cfg.shift_ns = strtoull(optarg, nullptr, 10) * 1000000ULL; break;
+      case 'r': cfg.seed = strtoull(optarg, nullptr, 10); break;
+      case 'o': cfg.prefix = optarg; break;
+      default: usage(argv[0]); return 1;
+    }
+  }
+  if (optind != argc || cfg.pattern < 0 || cfg.backing < 0 || cfg.threads <= 0 || !cfg.bytes ||
+      cfg.seconds <= 0 || !cfg.shift_ns || cfg.hot_frac <= 0 || cfg.hot_frac > 1 ||
+      !(cfg.hot_prob >= 0 && cfg.hot_prob <= 1)) {
+    usage(argv[0]);
+    return 1;
+  }
+
+  uint64_t psize = backing_sizes[cfg.backing];
+  if (cfg.pattern == PAT_ZIPF)
+    build_zipf((cfg.bytes + psize - 1) / psize * psize >> PAGE_SHIFT);
+
+  std::vector<worker> ws(cfg.threads);
+  std::vector<std::thread> th;
+  for (int i = 0; i < cfg.threads; i++) {
+    worker &w = ws[i];
+    w.id = i;
+    if (!cfg.nodes.empty())
+      w.node = cfg.nodes[i % cfg.nodes.size()];
+    if (!cfg.memnodes.empty())
+      w.memnode = cfg.memnodes[i % cfg.memnodes.size()];
+    if (!cfg.cpus.empty())
+      w.cpu = cfg.cpus[i % cfg.cpus.size()];
+    th.emplace_back(run_worker, &w);
+  }
+  while (ready.load() < cfg.threads)
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+
+  for (const worker &w : ws) {
+    if (!w.ok) {
+      fprintf(stderr, "thread %d could not set up its buffer\n", w.id);
+      stop = true;
+      go = true;
+      for (auto &t : th)
+        t.join();
+      return 1;
+    }
+  }
+
+  printf("pid %d, pattern %s, %d thread(s) x %" PRIu64 " MiB, backing %s, %.1f s\n",
+         (int)getpid(), pattern_names[cfg.pattern], cfg.threads, cfg.bytes >> 20,
+         backing_names[cfg.backing], cfg.seconds);
+  fflush(stdout);
+
+  start_ns = now_ns();
+  go.store(true, std::memory_order_release);
+  std::this_thread::sleep_for(std::chrono::nanoseconds((uint64_t)(cfg.seconds * 1e9)));
+  stop = true;
+  for (auto &t : th)
+    t.join();
+  end_ns = now_ns();
+
+  uint64_t total = 0;
+  for (const worker &w : ws) {
+    total += w.reads;
+    printf("thread %d tid %d cpu %d node %d buf %p-%p reads %" PRIu64 "\n", w.id, w.tid, w.cpu,
+           w.memnode >= 0 ? w.memnode : w.node, (void *)w.buf, (void *)(w.buf + w.len), w.reads);
+  }
+  double secs = (end_ns - start_ns) / 1e9;
+  printf("%" PRIu64 " reads, %.1f M reads/s, start_ns %" PRIu64 " end_ns %" PRIu64 "\n", total,
+         total / secs / 1e6, start_ns, end_ns);
+
+  if (write_counts(ws) < 0 || write_pagemap(ws) < 0)
+    return 1;
+  return 0;
+}
@@ -0,0 +1,201 @@
+#!/usr/bin/env python3
+# -*- coding: utf-8 -*-
+"""
+score_hotness.py  ─ score IBS hotness against gt_workload ground truth
+-----------------------------------------------------
+• truth: gt_counts.csv (exact reads per 4 KiB page per window) and
+  gt_pagemap.csv (vaddr -> pfn/node/page_size) written by gt_workload.
+• samples: ibs_samples.csv from ibs_reader, matched by pid + lin_addr
+  (default) or by phys_addr through the pagemap pfns (--match paddr).
+• per window: the top --hot fraction of pages by true count is the hot set,
+  the same number of pages with the most samples is the sampled hot set.
+  precision / recall of the sampled hot set and Spearman rank correlation of
+  samples vs. true counts over all buffer pages are printed.
+• --granularity mapping scores at each page's backing size from the pagemap
+  (2M THP where the kernel really used one, hugetlb).
+• --time filters samples to each window; needs ibs_reader samples on the
+  same clock (IBS_CLOCK=monotonic), otherwise all samples score the whole run.
+• --append adds one row per window to a CSV to compare sample periods.
+Standard library only.
+"""
+
+from __future__ import annotations
+import argparse
+import csv
+import math
+import os
+from collections import Counter
+from pathlib import Path
+
+
+def parse_args() -> argparse.Namespace:
+    ap = argparse.ArgumentParser(description="precision/recall/Spearman of IBS hotness vs. ground truth")
+    ap.add_argument("samples", type=Path, help="ibs_samples.csv")
+    ap.add_argument("--counts", type=Path, default=Path("gt_counts.csv"), help="gt_workload counts")
+    ap.add_argument("--pagemap", type=Path, default=Path("gt_pagemap.csv"), help="gt_workload pagemap")
+    ap.add_argument("--match", choices=["vaddr", "paddr"], default="vaddr",
+                    help="join samples on lin_addr+pid or on phys_addr")
+    ap.add_argument("--granularity", choices=["4k", "mapping"], default="4k",
+                    help="score 4 KiB pages or whole backing pages")
+    ap.add_argument("--hot", type=float, default=0.1, help="hot set fraction of pages (default 0.1)")
+    ap.add_argument("--time", action="store_true", help="only count samples inside each window")
+    ap.add_argument("--label", default="", help="label for --append (e.g. the sample period)")
+    ap.add_argument("--append", type=Path, help="append per-window scores to this CSV")
+    return ap.parse_args()
+
+
+COL_TIME, COL_PID, COL_LIN, COL_PHYS = 0, 1, 5, 6
+
+
+def load_pagemap(path: Path, granularity: str):
+    """vaddr(4K) -> unit key, pfn -> unit key, pid, unit list"""
+    by_vaddr, by_pfn, units = {}, {}, []
+    seen = set()
+    pid = None
+    with path.open(newline="") as f:
+        for row in csv.DictReader(f):
+            pid = int(row["pid"])
+            va = int(row["vaddr"], 16)
+            size = int(row["page_size"]) if granularity == "mapping" else 4096
+            unit = va & ~(size - 1)
+            by_vaddr[va] = unit
+            pfn = int(row["pfn"], 16)
+            if pfn:
+                by_pfn[pfn] = unit
+            if unit not in seen:
+                seen.add(unit)
+                units.append(unit)
+    return by_vaddr, by_pfn, pid, units
+
+
+def load_truth(path: Path, by_vaddr):
+    """window -> (start_ns, end_ns, Counter(unit -> reads))"""
+    windows = {}
+    with path.open(newline="") as f:
+        for row in csv.DictReader(f):
+            w = int(row["window"])
+            if w not in windows:
+                windows[w] = (int(row["start_ns"]), int(row["end_ns"]), Counter())
+            unit = by_vaddr.get(int(row["vaddr"], 16))
+            if unit is not None:
+                windows[w][2][unit] += int(row["count"])
+    return windows
+
+
+def load_samples(path: Path, match: str, pid, by_vaddr, by_pfn):
+    """[(time_ns, unit)] for samples that hit the buffers"""
+    hits = []
+    total = 0
+    with path.open(newline="") as f:
+        rd = csv.reader(f)
+        next(rd, None)
+        for row in rd:
+            if len(row) <= COL_PHYS:
+                continue
+            total += 1
+            try:
+                if match == "vaddr":
+                    if int(row[COL_PID]) != pid:
+                        continue
+                    unit = by_vaddr.get(int(row[COL_LIN], 16) & ~0xFFF)
+                else:
+                    unit = by_pfn.get(int(row[COL_PHYS], 16) >> 12)
+            except ValueError:
+                continue
+            if unit is not None:
+                hits.append((int(row[COL_TIME]), unit))
+    return hits, total
+
+
+def ranks(values):
+    """average ranks, ties share the mean rank"""
+    order = sorted(range(len(values)), key=lambda i: values[i])
+    r = [0.0] * len(values)
+    i = 0
+    while i < len(order):
+        j = i
+        while j + 1 < len(order) and values[order[j + 1]] == values[order[i]]:
+            j += 1
+        for k in range(i, j + 1):
+            r[order[k]] = (i + j) / 2.0 + 1
+        i = j + 1
+    return r
+
+
+def spearman(xs, ys) -> float:
+    if len(xs) < 2:
+        return float("nan")
+    rx, ry = ranks(xs), ranks(ys)
+    mx, my = sum(rx) / len(rx), sum(ry) / len(ry)
+    cov = sum((a - mx) * (b - my) for a, b in zip(rx, ry))
+    vx = sum((a - mx) ** 2 for a in rx)
+    vy = sum((b - my) ** 2 for b in ry)
+    return cov / math.sqrt(vx * vy) if vx > 0 and vy > 0 else float("nan")
+
+
+def score(units, truth: Counter, sampled: Counter, hot: float):
+    k = max(1, int(math.ceil(len(units) * hot)))
+    true_hot = set(sorted(units, key=lambda u: -truth[u])[:k])
+    # only pages that were sampled at all can be called hot
+    samp_hot = set(sorted((u for u in units if sampled[u]), key=lambda u: -sampled[u])[:k])
+    inter = len(true_hot & samp_hot)
+    precision = inter / len(samp_hot) if samp_hot else 0.0
+    recall = inter / len(true_hot)
+    rho = spearman([truth[u] for u in units], [sampled[u] for u in units])
+    return k, precision, recall, rho
+
+
+def main() -> None:
+    args = parse_args()
+    by_vaddr, by_pfn, pid, units = load_pagemap(args.pagemap, args.granularity)
+    if not units:
+        raise SystemExit(f"{args.pagemap}: no pages")
+    if args.match == "paddr" and not by_pfn:
+        raise SystemExit(f"{args.pagemap}: no pfns, rerun gt_workload as root or use --match vaddr")
+    windows = load_truth(args.counts, by_vaddr)
+    hits, total = load_samples(args.samples, args.match, pid, by_vaddr, by_pfn)
+
+    print(f"pid {pid}, {len(units)} {args.granularity} pages, {len(windows)} window(s)")
+    print(f"samples: {total} rows, {len(hits)} on the buffers")
+
+    use_time = args.time
+    if use_time and hits:
+        lo = min(s for s, _, _ in windows.values())
+        hi = max(e for _, e, _ in windows.values())
+        if not any(lo <= t < hi for t, _ in hits):
+            print("no sample falls in the run's CLOCK_MONOTONIC range, "
+                  "record with IBS_CLOCK=monotonic; scoring without --time")
+            use_time = False
+
+    if not use_time and len(windows) > 1:
+        print("without --time every window is scored against all samples")
+
+    rows = []
+    print(f"{'window':>6} {'reads':>12} {'samples':>8} {'1/rate':>8} {'hot_k':>6} "
+          f"{'precision':>9} {'recall':>7} {'spearman':>8}")
+    for w in sorted(windows):
+        start, end, truth = windows[w]
+        if use_time:
+            sampled = Counter(u for t, u in hits if start <= t < end)
+        else:
+            sampled = Counter(u for _, u in hits)
+        reads = sum(truth.values())
+        nsamp = sum(sampled.values())
+        k, p, r, rho = score(units, truth, sampled, args.hot)
+        inv = reads / nsamp if nsamp else float("inf")
+        print(f"{w:>6} {reads:>12} {nsamp:>8} {inv:>8.0f} {k:>6} {p:>9.3f} {r:>7.3f} {rho:>8.3f}")
+        rows.append([args.label, w, start, end, reads, nsamp, k, f"{p:.4f}", f"{r:.4f}", f"{rho:.4f}"])
+
+    if args.append:
+        new = not args.append.exists() or os.path.getsize(args.append) == 0
+        with args.append.open("a", newline="") as f:
+            wr = csv.writer(f)
+            if new:
+                wr.writerow(["label", "window", "start_ns", "end_ns", "reads", "samples",
+                             "hot_k", "precision", "recall", "spearman"])
+            wr.writerows(rows)
+        print(f"appended {len(rows)} row(s) to {args.append}")
+
+
+if __name__ == "__main__":
+    main()
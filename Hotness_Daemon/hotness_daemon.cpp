@@ -0,0 +1,186 @@
+/*
+ * hotness_daemon.cpp  ——  act on IBS hotness: promote hot pages, cool cold ones
+ *
+ *   sudo ./hotness_daemon -p <pid> [options] <ibs_samples.csv>
+ *
+ *   Reads ibs_reader rows for one pid, either a finished recording or, with
+ *   -f, the live file while ibs_reader is still appending to it. Every sample
+ *   bumps an exponentially decayed score of its page (huge pages count as one
+ *   page when page_size is known). Rows come from per-CPU buffers, so time can
+ *   step back between them; a late sample adds to the score without decay.
+ *   Every interval of sample time:
+ *
+ *     promote  pages with score >= hot that are not on the fast node are moved
+ *              there with move_pages(), hottest first
+ *     cool     pages seen before whose score fell below cold and that were not
+ *              sampled for cold_age are merged into ranges and passed to
+ *              process_madvise(MADV_COLD or MADV_PAGEOUT)
+ *
+ *   Epochs run on the time_ns of every row, not only the target's, so pages
+ *   keep aging while the target is quiet; with -f an idle file advances the
+ *   clock from the wall time since the last row.
+ *
+ *   Both actions are capped per second. With -n nothing is called, only the
+ *   would-be actions are counted, so policy and throughput can be checked on a
+ *   recorded file on a machine without IBS (or without the target process).
+ *
+ *   -f           follow the file as it grows (Ctrl-C exit)
+ *   -n           dry run
+ *   -F node      fast node for promotion (default 0)
+ *   -i ms        policy interval (default 1000)
+ *   -H ms        score half-life (default 2000)
+ *   -t score     hot threshold (default 4)
+ *   -c score     cold threshold (default 0.5)
+ *   -a ms        cold only after this long without a sample (default 10000)
+ *   -P pages/s   promotion limit (default 25600, 100 MiB/s of 4K pages)
+ *   -C pages/s   cooling limit (default 25600)
+ *   -m advice    cold | pageout (default cold)
+ *   -s speed     recorded file pacing: 0 as fast as possible (default), 1 real time
+ */
+#include <getopt.h>
+#include <signal.h>
+
+#include <chrono>
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+
+#include "hotness_policy.h"
+
+/* ibs_samples.csv columns */
+#define COL_TIME 0
+#define COL_PID 1
+#define COL_LIN_ADDR 5
+#define COL_MEM_NODE 9
+#define COL_PAGE_SIZE 14
+#define NR_COLS 15
+
+static volatile sig_atomic_t running = 1;
+static void sigh(int) { running = 0; }
+
+/* split a CSV row in place, returns the number of columns */
+static int split_row(char *line, char **cols, int max) {
+  int n = 0;
+  cols[n++] = line;
+  for (char *p = line; *p && n < max; p++) {
+    if (*p == ',') {
+      *p = '\0';
+      cols[n++] = p + 1;
+    }
+  }
+  return n;
+}
+
+static void usage(const char *prog) {
+  fprintf(stderr,
+          "Usage: sudo %s -p pid [-f] [-n] [-F fast_node] [-i ms] [-H ms] [-t hot] [-c cold]\n"
+          "       [-a ms] [-P pages/s] [-C pages/s] [-m cold|pageout] [-s speed] <ibs_samples.csv>\n",
+          prog);
+}
+
+int main(int argc, char **argv) {
+  config cfg;
+  int opt;
+  while ((opt = getopt(argc, argv, "p:fnF:i:H:t:c:a:P:C:m:s:")) != -1) {
+    switch (opt) {
+      case 'p': cfg.pid = atoi(optarg); break;
+      case 'f': cfg.follow = true; break;
+      case 'n': cfg.dry_run = true; break;
+      case 'F': cfg.fast_node = atoi(optarg); break;
+      case 'i': cfg.interval_ns = strtoull(optarg, nullptr, 10) * 1000000ULL; break;
+      case 'H': cfg.half_life_ns = atof(optarg) * 1e6; break;
+      case 't': cfg.hot = atof(optarg); break;
+      case 'c': cfg.cold = atof(optarg); break;
+      case 'a': cfg.cold_age_ns = strtoull(optarg, nullptr, 10) * 1000000ULL; break;
+      case 'P': cfg.promote_rate = strtoull(optarg, nullptr, 10); break;
+      case 'C': cfg.cool_rate = strtoull(optarg, nullptr, 10); break;
+      case 'm': cfg.advice = !strcmp(optarg, "pageout") ? MADV_PAGEOUT : MADV_COLD; break;
+      case 's': cfg.speed = atof(optarg); break;
+      default: usage(argv[0]); return 1;
+    }
+  }
+  if (optind + 1 != argc || cfg.pid <= 0 || !cfg.interval_ns || cfg.half_life_ns <= 0) {
+    usage(argv[0]);
+    return 1;
+  }
+
+  FILE *in = fopen(argv[optind], "r");
+  if (!in) {
+    perror(argv[optind]);
+    return 1;
+  }
+  signal(SIGINT, sigh);
+  signal(SIGTERM, sigh);
+
+  daemon_state st(cfg);
+  if (!st.open_target())
+    return 1;
+
+  auto wall0 = std::chrono::steady_clock::now();
+  uint64_t ts0 = 0;
+  uint64_t last_ts = 0; /* newest row time and when it was read, for the idle tick */
+  auto last_wall = wall0;
+  std::string pending;
+  char buf[1024];
+  bool header = true;
+  uint64_t rows = 0;
+  while (running) {
+    if (!fgets(buf, sizeof(buf), in)) {
+      if (!cfg.follow)
+        break;
+      clearerr(in); /* ibs_reader flushes about once a second */
+      std::this_thread::sleep_for(std::chrono::milliseconds(100));
+      if (last_ts) {
+        auto idle = std::chrono::steady_clock::now() - last_wall;
+        st.maybe_run(last_ts + std::chrono::duration_cast<std::chrono::nanoseconds>(idle).count());
+      }
+      continue;
+    }
+    pending += buf;
+    if (pending.back() != '\n')
+      continue; /* partial line, the writer is mid-row */
+    if (header) {
+      header = false;
+      pending.clear();
+      continue;
+    }
+
+    char *cols[NR_COLS];
+    int n = split_row(&pending[0], cols, NR_COLS);
+    rows++;
+    uint64_t ts = n > COL_LIN_ADDR ? strtoull(cols[COL_TIME], nullptr, 10) : 0;
+    if (ts) {
+      /* -s paces a recording like the original run */
+      if (!cfg.follow && cfg.speed > 0) {
+        if (!ts0)
+          ts0 = ts;
+        uint64_t rel = ts > ts0 ? ts - ts0 : 0; /* rows of another CPU can be earlier */
+        auto due = wall0 + std::chrono::nanoseconds((uint64_t)(rel / cfg.speed));
+        std::this_thread::sleep_until(due);
+      }
+      if (ts > last_ts) {
+        last_ts = ts;
+        last_wall = std::chrono::steady_clock::now();
+      }
+
+      uint64_t vaddr = strtoull(cols[COL_LIN_ADDR], nullptr, 0);
+      if (atoi(cols[COL_PID]) == cfg.pid && vaddr) {
+        int node = n > COL_MEM_NODE ? atoi(cols[COL_MEM_NODE]) : -1;
+        uint64_t psize = n > COL_PAGE_SIZE ? strtoull(cols[COL_PAGE_SIZE], nullptr, 10) : 0;
+        st.add_sample(ts, vaddr, node, psize);
+      } else {
+        st.maybe_run(ts); /* other pids still move the clock */
+      }
+    }
+    pending.clear();
+  }
+  fclose(in);
+
+  double wall = std::chrono::duration<double>(std::chrono::steady_clock::now() - wall0).count();
+  printf("\n%" PRIu64 " rows read\n", rows);
+  st.print_totals(wall);
+  return 0;
+}
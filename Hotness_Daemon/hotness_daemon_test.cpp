@@ -0,0 +1,112 @@
+/*
+ * hotness_daemon_test.cpp  ——  the page policy of hotness_daemon, called directly
+ *
+ *   make test_hotness_daemon
+ *
+ *   Drives a dry-run daemon_state (hotness_policy.h) with samples and row
+ *   times and checks scores and the pages it would promote or cool:
+ *     - a sample older than the page's last one adds without decay,
+ *     - one page sampled from two CPUs, whose rows arrive in alternating
+ *       blocks with time stepping back, is promoted once,
+ *     - a target that goes quiet still cools as other rows move the clock,
+ *     - pages that do not fit the promote budget are skipped, not the rest.
+ */
+#include <assert.h>
+#include <math.h>
+#include <stdio.h>
+
+#include "hotness_policy.h"
+
+#define MS 1000000ULL
+
+static void test_decay() {
+  config cfg;
+  cfg.dry_run = true;
+  cfg.interval_ns = 1000000 * MS; /* no epoch */
+  daemon_state st(cfg);
+
+  st.add_sample(1000 * MS, 0x7f0000000010, 1, 4096);
+  st.add_sample(3000 * MS, 0x7f0000000020, 1, 4096); /* one half-life later */
+  const page_state *p = st.page(0x7f0000000000);
+  assert(p && fabs(p->score - 1.5) < 1e-9);
+  st.add_sample(2000 * MS, 0x7f0000000030, 1, 4096); /* another CPU, earlier */
+  assert(fabs(p->score - 2.5) < 1e-9 && p->last_ns == 3000 * MS);
+
+  st.add_sample(1000 * MS, 0x7f0000234567, 1, 2 << 20); /* keyed by the huge page */
+  p = st.page(0x7f0000200000);
+  assert(p && p->size == 2 << 20);
+  st.add_sample(1000 * MS, 0x7f0000300000, 1, 0); /* unknown size: 4K */
+  assert(st.page(0x7f0000300000)->size == 4096);
+  assert(st.stats().samples == 5);
+}
+
+static void test_interleaved_cpus() {
+  config cfg;
+  cfg.dry_run = true;
+  cfg.fast_node = 0;
+  cfg.interval_ns = 100 * MS;
+  cfg.hot = 5;
+  daemon_state st(cfg);
+
+  /* 20 blocks of 100 ms: cpu0 rows, then cpu1 rows that start earlier */
+  for (uint64_t k = 0; k < 20; k++) {
+    uint64_t base = (1000 + k * 100) * MS;
+    for (uint64_t t : {10, 40})
+      st.add_sample(base + t * MS, 0x7f0000000010, 1, 4096);
+    for (uint64_t t : {20, 50})
+      st.add_sample(base + t * MS, 0x7f0000000020, 1, 4096);
+    st.add_sample(base + 30 * MS, 0x7f0000005000, 0, 4096); /* already on the fast node */
+  }
+  assert(st.stats().samples == 100);
+  assert(st.stats().promote_pages == 1); /* the dry run remembers the move */
+  assert(st.stats().promote_capped == 0);
+  assert(st.page(0x7f0000000000)->node == 0 && st.page(0x7f0000000000)->moved);
+  assert(!st.page(0x7f0000005000)->moved);
+}
+
+static void test_quiet_target_cools() {
+  config cfg;
+  cfg.dry_run = true;
+  cfg.half_life_ns = 100 * MS;
+  cfg.cold_age_ns = 2000 * MS;
+  daemon_state st(cfg);
+
+  st.add_sample(1000 * MS, 0x7f0000001000, 1, 4096);
+  for (uint64_t t = 1500; t <= 2500; t += 500)
+    st.maybe_run(t * MS); /* rows of other pids */
+  assert(st.stats().cool_pages == 0); /* not cold_age yet */
+  for (uint64_t t = 3000; t <= 6000; t += 500)
+    st.maybe_run(t * MS);
+  assert(st.stats().cool_pages == 1 && st.page(0x7f0000001000)->cooled);
+}
+
+static void test_promote_budget() {
+  config cfg;
+  cfg.dry_run = true;
+  cfg.hot = 1;
+  cfg.promote_rate = 100; /* 100 4K pages in a 1 s epoch */
+  daemon_state st(cfg);
+
+  /* 150 4K pages hotter than one 2M page, all on the slow node */
+  for (uint64_t i = 0; i < 150; i++)
+    for (int k = 0; k < 3; k++)
+      st.add_sample(500 * MS, 0x7f0000000000 + i * 4096, 1, 4096);
+  for (int k = 0; k < 2; k++)
+    st.add_sample(500 * MS, 0x7f0000400000, 1, 2 << 20);
+  st.maybe_run(1500 * MS);
+
+  /* 100 fit, 50 are left over, the huge page goes on its own */
+  assert(st.stats().epochs == 1);
+  assert(st.stats().promote_pages == 101);
+  assert(st.stats().promote_capped == 50);
+  assert(st.page(0x7f0000400000)->node == 0);
+}
+
+int main() {
+  test_decay();
+  test_interleaved_cpus();
+  test_quiet_target_cools();
+  test_promote_budget();
+  printf("All tests passed!\n");
+  return 0;
+}
@@ -0,0 +1,222 @@
+/*
+ * hotness_policy.cpp  ——  epochs, move_pages() promotion and process_madvise() cooling
+ */
+#include "hotness_policy.h"
+
+#include <errno.h>
+#include <linux/mempolicy.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cinttypes>
+#include <cstdio>
+
+bool daemon_state::open_target() {
+  if (cfg_.dry_run)
+    return true;
+  pidfd_ = syscall(SYS_pidfd_open, cfg_.pid, 0);
+  if (pidfd_ < 0) {
+    perror("pidfd_open");
+    return false;
+  }
+  return true;
+}
+
+void daemon_state::add_sample(uint64_t ts, uint64_t vaddr, int node, uint64_t page_size) {
+  if (page_size < PAGE_4K)
+    page_size = PAGE_4K;
+  page_state &p = pages_[vaddr & ~(page_size - 1)];
+  p.score = (p.last_ns ? decayed(p, ts) : 0) + 1;
+  p.last_ns = std::max(p.last_ns, ts);
+  p.size = page_size;
+  p.cooled = false;
+  /* a sample taken an epoch after the move shows where the page is now; a
+     recording replayed with -n never sees the move, so keep it there */
+  if (p.moved && !cfg_.dry_run && t_.epochs > p.moved_epoch)
+    p.moved = false;
+  if (node >= 0 && !p.moved)
+    p.node = node;
+  t_.samples++;
+  maybe_run(ts);
+}
+
+void daemon_state::maybe_run(uint64_t ts) {
+  if (!next_epoch_) {
+    next_epoch_ = last_epoch_ = ts;
+    next_epoch_ += cfg_.interval_ns;
+    return;
+  }
+  if (ts < next_epoch_)
+    return;
+  run_epoch(ts);
+  last_epoch_ = ts;
+  next_epoch_ = ts + cfg_.interval_ns;
+}
+
+void daemon_state::run_epoch(uint64_t now) {
+  auto t0 = std::chrono::steady_clock::now();
+  double secs = (double)(now - last_epoch_) / 1e9;
+  uint64_t promote_budget = std::max<uint64_t>(1, cfg_.promote_rate * secs);
+  uint64_t cool_budget = std::max<uint64_t>(1, cfg_.cool_rate * secs);
+
+  struct cand {
+    double score;
+    uint64_t addr;
+  };
+  std::vector<cand> hot;
+  std::vector<uint64_t> cold;
+  for (auto &kv : pages_) {
+    const page_state &p = kv.second;
+    double s = decayed(p, now);
+    if (s >= cfg_.hot && p.node != cfg_.fast_node)
+      hot.push_back({s, kv.first});
+    else if (s < cfg_.cold && !p.cooled && now >= p.last_ns + cfg_.cold_age_ns)
+      cold.push_back(kv.first);
+  }
+
+  /*
+   * Hottest first within the rate limit, in 4K-page units. Pages that do not
+   * fit are skipped, not the end of the list, so a huge page cannot hold back
+   * the 4K pages behind it; one huge page larger than the whole budget may go
+   * per epoch, otherwise a small -i or -P would never move it.
+   */
+  std::sort(hot.begin(), hot.end(), [](const cand &a, const cand &b) { return a.score > b.score; });
+  std::vector<uint64_t> promote_list;
+  uint64_t used = 0;
+  bool oversize = false;
+  for (const cand &c : hot) {
+    uint64_t n = pages_[c.addr].size / PAGE_4K;
+    if (n > promote_budget && !oversize) {
+      oversize = true;
+    } else if (used + n > promote_budget) {
+      t_.promote_capped++;
+      continue;
+    }
+    used += n;
+    promote_list.push_back(c.addr);
+  }
+
+  /* cold pages merged into address ranges, lowest addresses first */
+  std::sort(cold.begin(), cold.end());
+  std::vector<std::pair<uint64_t, uint64_t>> ranges;
+  used = 0;
+  for (uint64_t a : cold) {
+    page_state &p = pages_[a];
+    uint64_t n = p.size / PAGE_4K;
+    if (used + n > cool_budget) {
+      t_.cool_capped++;
+      continue;
+    }
+    used += n;
+    p.cooled = true;
+    if (!ranges.empty() && ranges.back().first + ranges.back().second == a)
+      ranges.back().second += p.size;
+    else
+      ranges.push_back(std::make_pair(a, p.size));
+  }
+
+  auto t1 = std::chrono::steady_clock::now();
+  promote(promote_list);
+  cool(ranges);
+  auto t2 = std::chrono::steady_clock::now();
+
+  t_.epochs++;
+  t_.policy_s += std::chrono::duration<double>(t1 - t0).count();
+  t_.syscall_s += std::chrono::duration<double>(t2 - t1).count();
+  printf("epoch %-6" PRIu64 " pages %-8zu hot %-6zu promote %-6zu cold %-6zu ranges %-5zu%s\n",
+         t_.epochs, pages_.size(), hot.size(), promote_list.size(), cold.size(), ranges.size(),
+         cfg_.dry_run ? " (dry run)" : "");
+  fflush(stdout);
+}
+
+void daemon_state::promote(std::vector<uint64_t> &list) {
+  for (size_t i = 0; i < list.size(); i += BATCH) {
+    size_t n = std::min<size_t>(BATCH, list.size() - i);
+    t_.promote_pages += n;
+    t_.promote_calls++;
+    if (cfg_.dry_run) {
+      for (size_t j = 0; j < n; j++) {
+        pages_[list[i + j]].node = cfg_.fast_node;
+        pages_[list[i + j]].moved = true;
+        pages_[list[i + j]].moved_epoch = t_.epochs + 1;
+      }
+      continue;
+    }
+
+    void *addrs[BATCH];
+    int nodes[BATCH], status[BATCH];
+    for (size_t j = 0; j < n; j++) {
+      addrs[j] = (void *)list[i + j];
+      nodes[j] = cfg_.fast_node;
+      status[j] = -1;
+    }
+    long r = syscall(SYS_move_pages, cfg_.pid, n, addrs, nodes, status, MPOL_MF_MOVE);
+    if (r < 0) {
+      perror("move_pages");
+      t_.promote_fail += n;
+      continue;
+    }
+    for (size_t j = 0; j < n; j++) {
+      page_state &p = pages_[list[i + j]];
+      if (status[j] >= 0) {
+        t_.promote_ok++;
+        p.node = status[j];
+        p.moved = true;
+        p.moved_epoch = t_.epochs + 1; /* run_epoch counts this epoch after promote() */
+      } else {
+        t_.promote_fail++;
+        if (status[j] == -ENOENT || status[j] == -EFAULT)
+          pages_.erase(list[i + j]); /* unmapped or not present any more */
+      }
+    }
+  }
+}
+
+void daemon_state::cool(std::vector<std::pair<uint64_t, uint64_t>> &ranges) {
+  for (size_t i = 0; i < ranges.size(); i += BATCH) {
+    size_t n = std::min<size_t>(BATCH, ranges.size() - i);
+    t_.cool_calls++;
+    t_.cool_ranges += n;
+    for (size_t j = 0; j < n; j++)
+      t_.cool_pages += ranges[i + j].second / PAGE_4K;
+    if (cfg_.dry_run)
+      continue;
+
+    struct iovec iov[BATCH];
+    size_t bytes = 0;
+    for (size_t j = 0; j < n; j++) {
+      iov[j].iov_base = (void *)ranges[i + j].first;
+      iov[j].iov_len = ranges[i + j].second;
+      bytes += ranges[i + j].second;
+    }
+    long r = syscall(SYS_process_madvise, pidfd_, iov, n, cfg_.advice, 0);
+    if (r < 0) {
+      perror("process_madvise");
+      t_.cool_fail += n;
+    } else if ((size_t)r < bytes) {
+      t_.cool_fail++; /* stopped early at an unmapped range */
+    }
+  }
+}
+
+void daemon_state::print_totals(double wall_s) const {
+  printf("samples of pid %d: %" PRIu64 ", %.2f s, %.0f samples/s\n", cfg_.pid, t_.samples, wall_s, wall_s > 0 ? t_.samples / wall_s : 0.0);
+  printf("epochs %" PRIu64 ", policy %.3f s, syscalls %.3f s, tracked pages %zu\n", t_.epochs,
+         t_.policy_s, t_.syscall_s, pages_.size());
+  printf("promote: %" PRIu64 " pages in %" PRIu64 " move_pages calls", t_.promote_pages,
+         t_.promote_calls);
+  if (!cfg_.dry_run)
+    printf(", %" PRIu64 " moved, %" PRIu64 " failed", t_.promote_ok, t_.promote_fail);
+  printf(", %" PRIu64 " left over by the rate limit\n", t_.promote_capped);
+  printf("cool (%s): %" PRIu64 " pages in %" PRIu64 " ranges, %" PRIu64 " process_madvise calls",
+         cfg_.advice == MADV_PAGEOUT ? "pageout" : "cold", t_.cool_pages, t_.cool_ranges,
+         t_.cool_calls);
+  if (!cfg_.dry_run)
+    printf(", %" PRIu64 " failed", t_.cool_fail);
+  printf(", %" PRIu64 " left over by the rate limit\n", t_.cool_capped);
+  if (cfg_.dry_run)
+    printf("dry run: no page was moved or advised\n");
+}
@@ -0,0 +1,83 @@
+/*
+ * hotness_policy.h  ——  per-page scores and the promote / cool policy
+ *
+ *   daemon_state is fed samples and row times by hotness_daemon.cpp and runs
+ *   an epoch every interval of sample time. With config::dry_run it makes no
+ *   syscalls, so the policy can be driven directly (hotness_daemon_test).
+ */
+#ifndef HOTNESS_POLICY_H
+#define HOTNESS_POLICY_H
+
+#include <sys/mman.h>
+
+#include <cmath>
+#include <cstdint>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#define PAGE_4K 4096ULL
+#define BATCH 1024 /* pages per move_pages call, iovecs per process_madvise call */
+
+struct config {
+  int pid = 0;
+  bool follow = false, dry_run = false;
+  int fast_node = 0;
+  uint64_t interval_ns = 1000000000ULL;
+  double half_life_ns = 2e9;
+  double hot = 4, cold = 0.5;
+  uint64_t cold_age_ns = 10000000000ULL;
+  uint64_t promote_rate = 25600, cool_rate = 25600;
+  int advice = MADV_COLD;
+  double speed = 0;
+};
+
+struct page_state {
+  double score = 0;
+  uint64_t last_ns = 0;
+  uint64_t size = PAGE_4K;
+  int node = -1;       /* last node seen in a sample or set by move_pages */
+  bool moved = false;  /* promoted by us, later samples may carry the old node */
+  uint64_t moved_epoch = 0;
+  bool cooled = false; /* already advised since the last sample */
+};
+
+struct totals {
+  uint64_t samples = 0, epochs = 0;
+  uint64_t promote_pages = 0, promote_ok = 0, promote_fail = 0, promote_calls = 0;
+  uint64_t cool_pages = 0, cool_ranges = 0, cool_calls = 0, cool_fail = 0;
+  uint64_t promote_capped = 0, cool_capped = 0;
+  double policy_s = 0, syscall_s = 0;
+};
+
+class daemon_state {
+ public:
+  explicit daemon_state(const config &cfg) : cfg_(cfg) {}
+  bool open_target();
+  void add_sample(uint64_t ts, uint64_t vaddr, int node, uint64_t page_size);
+  void maybe_run(uint64_t ts);
+  void print_totals(double wall_s) const;
+  const totals &stats() const { return t_; }
+  const page_state *page(uint64_t addr) const {
+    auto it = pages_.find(addr);
+    return it == pages_.end() ? nullptr : &it->second;
+  }
+
+ private:
+  double decayed(const page_state &p, uint64_t now) const {
+    if (now <= p.last_ns)
+      return p.score;
+    return p.score * exp2(-(double)(now - p.last_ns) / cfg_.half_life_ns);
+  }
+  void run_epoch(uint64_t now);
+  void promote(std::vector<uint64_t> &pages);
+  void cool(std::vector<std::pair<uint64_t, uint64_t>> &ranges);
+
+  const config &cfg_;
+  int pidfd_ = -1;
+  std::unordered_map<uint64_t, page_state> pages_;
+  uint64_t next_epoch_ = 0, last_epoch_ = 0;
+  totals t_;
+};
+
+#endif // HOTNESS_POLICY_H
@@ -0,0 +1,236 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * reclaim_profiler.bpf.c  ——  CO-RE reclaim latency / MGLRU generation profiler
+ *
+ * kprobe + kretprobe on shrink_node, shrink_lruvec and try_to_shrink_lruvec.
+ * Entry stores the start time and sc->nr_reclaimed/nr_scanned per (tid, fn);
+ * return folds latency into log2 histograms keyed by target cgroup and by
+ * process. try_to_shrink_lruvec entry also snapshots lrugen max_seq/min_seq
+ * and the per-generation page counts. Only the maps cross to user space.
+ */
+#include "vmlinux.h"
+#include <bpf/bpf_core_read.h>
+#include <bpf/bpf_helpers.h>
+#include <bpf/bpf_tracing.h>
+
+#include "reclaim_profiler.h"
+
+#define MAX_ENTRIES 10240
+#define MAX_ZONES 8
+
+struct start {
+    __u64 ts;
+    __u64 reclaimed;
+    __u64 scanned;
+    __u64 cgid;
+    struct scan_control *sc;     /* still live at return, read the deltas there */
+};
+
+struct {
+    __uint(type, BPF_MAP_TYPE_HASH);
+    __uint(max_entries, MAX_ENTRIES);
+    __type(key, __u64);              /* tid << 8 | fn */
+    __type(value, struct start);
+} starts SEC(".maps");
+
+struct {
+    __uint(type, BPF_MAP_TYPE_HASH);
+    __uint(max_entries, MAX_ENTRIES);
+    __type(key, struct cg_key);
+    __type(value, struct reclaim_hist);
+} hist_cg SEC(".maps");
+
+struct {
+    __uint(type, BPF_MAP_TYPE_HASH);
+    __uint(max_entries, MAX_ENTRIES);
+    __type(key, struct pid_key);
+    __type(value, struct reclaim_hist);
+} hist_pid SEC(".maps");
+
+struct {
+    __uint(type, BPF_MAP_TYPE_LRU_HASH);
+    __uint(max_entries, MAX_ENTRIES);
+    __type(key, __u64);              /* lruvec address */
+    __type(value, struct lrugen_snap);
+} lrugen SEC(".maps");
+
+static const struct reclaim_hist zero_hist;
+
+/* local flavors: lruvec->pgdat and mem_cgroup_per_node only exist with
+   CONFIG_MEMCG, CO-RE tells at load time whether they are there */
+struct lruvec___memcg {
+    struct pglist_data *pgdat;
+} __attribute__((preserve_access_index));
+
+struct mem_cgroup_per_node___rp {
+    struct lruvec lruvec;
+    struct mem_cgroup *memcg;
+} __attribute__((preserve_access_index));
+
+static __always_inline __u32 log2_u64(__u64 v) {
+    __u32 r = 0;
+    if (v >> 32) { v >>= 32; r += 32; }
+    if (v >> 16) { v >>= 16; r += 16; }
+    if (v >> 8) { v >>= 8; r += 8; }
+    if (v >> 4) { v >>= 4; r += 4; }
+    if (v >> 2) { v >>= 2; r += 2; }
+    if (v >> 1) r += 1;
+    return r;
+}
+
+static __always_inline __u64 memcg_cgid(struct mem_cgroup *memcg) {
+    if (!memcg)
+        return 0;
+    return BPF_CORE_READ(memcg, css.cgroup, kn, id);
+}
+
+static __always_inline void hist_add(struct reclaim_hist *h, __u64 delta,
+                                     __u64 reclaimed, __u64 scanned) {
+    __u32 slot = log2_u64(delta);
+    if (slot >= HIST_SLOTS)
+        slot = HIST_SLOTS - 1;
+    __sync_fetch_and_add(&h->slots[slot], 1);
+    __sync_fetch_and_add(&h->count, 1);
+    __sync_fetch_and_add(&h->total_ns, delta);
+    __sync_fetch_and_add(&h->reclaimed, reclaimed);
+    __sync_fetch_and_add(&h->scanned, scanned);
+    if (delta > h->max_ns)
+        h->max_ns = delta; /* racy max is fine for a profile */
+}
+
+static __always_inline void snap_lrugen(struct lruvec *lruvec) {
+    __u64 key = (__u64)lruvec;
+    struct lrugen_snap *s = bpf_map_lookup_elem(&lrugen, &key);
+    if (!s) {
+        struct lrugen_snap init = {};
+        bpf_map_update_elem(&lrugen, &key, &init, BPF_NOEXIST);
+        s = bpf_map_lookup_elem(&lrugen, &key);
+        if (!s)
+            return;
+    }
+
+    s->ts_ns = bpf_ktime_get_ns();
+    s->calls++;
+    s->max_seq = BPF_CORE_READ(lruvec, lrugen.max_seq);
+    bpf_core_read(&s->min_seq[0], sizeof(s->min_seq[0]), &lruvec->lrugen.min_seq[0]);
+    bpf_core_read(&s->min_seq[1], sizeof(s->min_seq[1]), &lruvec->lrugen.min_seq[1]);
+
+    struct pglist_data *pgdat;
+    if (bpf_core_field_exists(((struct lruvec___memcg *)0)->pgdat))
+        pgdat = BPF_CORE_READ((struct lruvec___memcg *)lruvec, pgdat);
+    else
+        pgdat = (void *)lruvec - bpf_core_field_offset(struct pglist_data, __lruvec);
+    s->node = BPF_CORE_READ(pgdat, node_id);
+
+    /* memcg lruvecs are embedded in mem_cgroup_per_node; with CONFIG_MEMCG=n
+       or cgroup_disable=memory it is pgdat->__lruvec (see mem_cgroup_lruvec) */
+    void *root = (void *)pgdat + bpf_core_field_offset(struct pglist_data, __lruvec);
+    if (!bpf_core_type_exists(struct mem_cgroup_per_node___rp) || (void *)lruvec == root) {
+        s->cgid = 0;
+    } else {
+        struct mem_cgroup_per_node___rp *pn =
+            (void *)lruvec - bpf_core_field_offset(struct mem_cgroup_per_node___rp, lruvec);
+        s->cgid = memcg_cgid(BPF_CORE_READ(pn, memcg));
+    }
+
+    /* long nr_pages[MAX_NR_GENS][ANON_AND_FILE][MAX_NR_ZONES]; MAX_NR_ZONES is config dependent */
+    void *base = (void *)lruvec + bpf_core_field_offset(lruvec->lrugen.nr_pages);
+    __u32 nr_zones = bpf_core_field_size(lruvec->lrugen.nr_pages) /
+                     (NR_GENS * NR_TYPES * sizeof(long));
+
+    for (int gen = 0; gen < NR_GENS; gen++) {
+        for (int type = 0; type < NR_TYPES; type++) {
+            __s64 sum = 0;
+            for (int zone = 0; zone < MAX_ZONES; zone++) {
+                long v = 0;
+                if (zone >= nr_zones)
+                    break;
+                bpf_probe_read_kernel(&v, sizeof(v),
+                                      base + ((gen * NR_TYPES + type) * nr_zones + zone) * sizeof(long));
+                sum += v;
+            }
+            s->nr_pages[gen][type] = sum;
+        }
+    }
+}
+
+static __always_inline int on_entry(__u32 fn, struct scan_control *sc) {
+    __u64 key = ((__u64)(__u32)bpf_get_current_pid_tgid() << 8) | fn;
+    struct start st = {
+        .ts = bpf_ktime_get_ns(),
+        .reclaimed = BPF_CORE_READ(sc, nr_reclaimed),
+        .scanned = BPF_CORE_READ(sc, nr_scanned),
+        .cgid = memcg_cgid(BPF_CORE_READ(sc, target_mem_cgroup)),
+        .sc = sc,
+    };
+    bpf_map_update_elem(&starts, &key, &st, BPF_ANY);
+    return 0;
+}
+
+static __always_inline int on_exit(__u32 fn) {
+    __u64 pid_tgid = bpf_get_current_pid_tgid();
+    __u64 key = ((__u64)(__u32)pid_tgid << 8) | fn;
+    struct start *st = bpf_map_lookup_elem(&starts, &key);
+    if (!st)
+        return 0;
+
+    __u64 delta = bpf_ktime_get_ns() - st->ts;
+    __u64 reclaimed = BPF_CORE_READ(st->sc, nr_reclaimed) - st->reclaimed;
+    __u64 scanned = BPF_CORE_READ(st->sc, nr_scanned) - st->scanned;
+    struct cg_key ck = {.cgid = st->cgid, .fn = fn};
+    struct pid_key pk = {.tgid = pid_tgid >> 32, .fn = fn};
+    bpf_map_delete_elem(&starts, &key);
+
+    struct reclaim_hist *h = bpf_map_lookup_elem(&hist_cg, &ck);
+    if (!h) {
+        bpf_map_update_elem(&hist_cg, &ck, &zero_hist, BPF_NOEXIST);
+        h = bpf_map_lookup_elem(&hist_cg, &ck);
+    }
+    if (h)
+        hist_add(h, delta, reclaimed, scanned);
+
+    h = bpf_map_lookup_elem(&hist_pid, &pk);
+    if (!h) {
+        bpf_map_update_elem(&hist_pid, &pk, &zero_hist, BPF_NOEXIST);
+        h = bpf_map_lookup_elem(&hist_pid, &pk);
+        if (h)
+            bpf_get_current_comm(h->comm, sizeof(h->comm));
+    }
+    if (h)
+        hist_add(h, delta, reclaimed, scanned);
+    return 0;
+}
+
+/* all three take scan_control as the second argument */
+SEC("kprobe/shrink_node")
+int BPF_KPROBE(shrink_node_entry, void *pgdat, struct scan_control *sc) {
+    return on_entry(FN_SHRINK_NODE, sc);
+}
+
+SEC("kretprobe/shrink_node")
+int BPF_KRETPROBE(shrink_node_exit) {
+    return on_exit(FN_SHRINK_NODE);
+}
+
+SEC("kprobe/shrink_lruvec")
+int BPF_KPROBE(shrink_lruvec_entry, struct lruvec *lruvec, struct scan_control *sc) {
+    return on_entry(FN_SHRINK_LRUVEC, sc);
+}
+
+SEC("kretprobe/shrink_lruvec")
+int BPF_KRETPROBE(shrink_lruvec_exit) {
+    return on_exit(FN_SHRINK_LRUVEC);
+}
+
+SEC("kprobe/try_to_shrink_lruvec")
+int BPF_KPROBE(try_to_shrink_lruvec_entry, struct lruvec *lruvec, struct scan_control *sc) {
+    snap_lrugen(lruvec);
+    return on_entry(FN_TRY_TO_SHRINK_LRUVEC, sc);
+}
+
+SEC("kretprobe/try_to_shrink_lruvec")
+int BPF_KRETPROBE(try_to_shrink_lruvec_exit) {
+    return on_exit(FN_TRY_TO_SHRINK_LRUVEC);
+}
+
+char LICENSE[] SEC("license") = "GPL";
@@ -0,0 +1,274 @@
+/*
+ * reclaim_profiler.cpp  ——  loader for reclaim_profiler.bpf.c
+ *
+ *   Attaches the shrink_node / shrink_lruvec / try_to_shrink_lruvec probes and
+ *   every interval prints, per target cgroup and per reclaiming process:
+ *     calls, avg/p50/p99/max latency (log2 buckets), pages reclaimed/scanned
+ *   plus the latest MGLRU generation snapshot of every lruvec seen.
+ *   Histograms are emptied after each report, so rows cover one interval;
+ *   -c keeps them cumulative since start.
+ *
+ *   Functions that are inlined on the running kernel cannot be probed; they are
+ *   reported and skipped, the rest keep working.
+ *
+ *   sudo ./reclaim_profiler [-i interval_s] [-d duration_s] [-c] [-v]
+ *     -c  cumulative histograms
+ *     -v  also print the full latency histograms
+ */
+#include <bpf/libbpf.h>
+#include <bpf/bpf.h>
+#include <dirent.h>
+#include <getopt.h>
+#include <signal.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cinttypes>
+#include <cstdarg>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "reclaim_profiler.h"
+#include "reclaim_profiler.skel.h"
+
+static volatile sig_atomic_t running = 1;
+static void sigh(int) { running = 0; }
+
+static const char *fn_names[FN_NR] = {"shrink_node", "shrink_lruvec", "try_to_shrink_lruvec"};
+
+// cgroup v2 ids are kernfs inode numbers, walk /sys/fs/cgroup once per report
+static void scan_cgroups(const std::string &dir, std::unordered_map<uint64_t, std::string> &out) {
+  struct stat st;
+  if (stat(dir.c_str(), &st) == 0)
+    out[st.st_ino] = dir.size() > 14 ? dir.substr(14) : "/";
+
+  DIR *d = opendir(dir.c_str());
+  if (!d)
+    return;
+  while (struct dirent *e = readdir(d)) {
+    if (e->d_type != DT_DIR || e->d_name[0] == '.')
+      continue;
+    scan_cgroups(dir + "/" + e->d_name, out);
+  }
+  closedir(d);
+}
+
+static uint64_t hist_percentile(const reclaim_hist &h, double p) {
+  if (!h.count)
+    return 0;
+  uint64_t want = (uint64_t)(h.count * p + 0.5), seen = 0;
+  if (!want)
+    want = 1;
+  for (int i = 0; i < HIST_SLOTS; i++) {
+    seen += h.slots[i];
+    if (seen >= want)
+      return i ? (1ULL << (i + 1)) - 1 : 1;  // upper bound of the bucket
+  }
+  return h.max_ns;
+}
+
+static void print_hist(const reclaim_hist &h) {
+  uint64_t peak = 0;
+  for (int i = 0; i < HIST_SLOTS; i++)
+    peak = h.slots[i] > peak ? h.slots[i] : peak;
+  for (int i = 0; i < HIST_SLOTS; i++) {
+    if (!h.slots[i])
+      continue;
+    int bar = peak ? (int)(h.slots[i] * 40 / peak) : 0;
+    printf("      %12llu -> %-12llu : %-10llu |%.*s\n", i ? 1ULL << i : 0ULL,
+           (1ULL << (i + 1)) - 1, (unsigned long long)h.slots[i], bar,
+           "****************************************");
+  }
+}
+
+static void print_row(const char *who, int fn, const reclaim_hist &h, bool verbose) {
+  printf("  %-32s %-22s %8llu %10.1f %10llu %10llu %10.1f %10llu %10llu\n", who, fn_names[fn],
+         (unsigned long long)h.count, h.count ? h.total_ns / 1e3 / h.count : 0.0,
+         (unsigned long long)hist_percentile(h, 0.5) / 1000,
+         (unsigned long long)hist_percentile(h, 0.99) / 1000, h.max_ns / 1e3,
+         (unsigned long long)h.reclaimed, (unsigned long long)h.scanned);
+  if (verbose)
+    print_hist(h);
+}
+
+// keys first: deleting while walking with get_next_key restarts the walk
+template <typename K>
+static std::vector<K> map_keys(int fd) {
+  std::vector<K> keys;
+  K key, next;
+  void *prev = nullptr;
+  while (bpf_map_get_next_key(fd, prev, &next) == 0) {
+    keys.push_back(next);
+    key = next;
+    prev = &key;
+  }
+  return keys;
+}
+
+// lookup then delete right away, so at most a few in-flight updates are lost
+static bool take(int fd, const void *key, void *value, bool reset) {
+  if (bpf_map_lookup_elem(fd, key, value) != 0)
+    return false;
+  if (reset)
+    bpf_map_delete_elem(fd, key);
+  return true;
+}
+
+static void print_header(const char *who) {
+  printf("  %-32s %-22s %8s %10s %10s %10s %10s %10s %10s\n", who, "function", "calls", "avg_us",
+         "p50_us", "p99_us", "max_us", "reclaimed", "scanned");
+}
+
+static void report_cgroups(int fd, bool verbose, bool reset) {
+  std::unordered_map<uint64_t, std::string> paths;
+  scan_cgroups("/sys/fs/cgroup", paths);
+
+  printf("== per target cgroup (global = kswapd / direct reclaim without memcg) ==\n");
+  print_header("cgroup");
+  reclaim_hist h;
+  for (const cg_key &key : map_keys<cg_key>(fd)) {
+    if (take(fd, &key, &h, reset) && key.fn < FN_NR) {
+      std::string who = "global";
+      if (key.cgid) {
+        auto it = paths.find(key.cgid);
+        who = it != paths.end() ? it->second : "cgid:" + std::to_string(key.cgid);
+      }
+      print_row(who.c_str(), key.fn, h, verbose);
+    }
+  }
+}
+
+static void report_pids(int fd, bool verbose, bool reset) {
+  printf("== per reclaiming process ==\n");
+  print_header("pid/comm");
+  reclaim_hist h;
+  for (const pid_key &key : map_keys<pid_key>(fd)) {
+    if (take(fd, &key, &h, reset) && key.fn < FN_NR) {
+      char who[48];
+      snprintf(who, sizeof(who), "%u/%.*s", key.tgid, TASK_COMM_LEN, h.comm);
+      print_row(who, key.fn, h, verbose);
+    }
+  }
+}
+
+static void report_lrugen(int fd) {
+  std::unordered_map<uint64_t, std::string> paths;
+  scan_cgroups("/sys/fs/cgroup", paths);
+
+  printf("== MGLRU generations at the last try_to_shrink_lruvec (pages anon/file) ==\n");
+  uint64_t key, next;
+  lrugen_snap s;
+  void *prev = nullptr;
+  while (bpf_map_get_next_key(fd, prev, &next) == 0) {
+    if (bpf_map_lookup_elem(fd, &next, &s) == 0) {
+      auto it = paths.find(s.cgid);
+      std::string who = !s.cgid ? "root" : it != paths.end() ? it->second : "cgid:" + std::to_string(s.cgid);
+      printf("  lruvec %#" PRIx64 " node %u %s calls %u max_seq %llu min_seq anon %llu file %llu\n", next,
+             s.node, who.c_str(), s.calls, (unsigned long long)s.max_seq,
+             (unsigned long long)s.min_seq[0], (unsigned long long)s.min_seq[1]);
+
+      uint64_t min_seq = s.min_seq[0] < s.min_seq[1] ? s.min_seq[0] : s.min_seq[1];
+      for (uint64_t seq = min_seq; seq <= s.max_seq && seq < min_seq + NR_GENS; seq++) {
+        int gen = seq % NR_GENS;
+        printf("    seq %-8llu gen %d %12lld %12lld\n", (unsigned long long)seq, gen,
+               (long long)s.nr_pages[gen][0], (long long)s.nr_pages[gen][1]);
+      }
+    }
+    key = next;
+    prev = &key;
+  }
+}
+
+static int libbpf_print(enum libbpf_print_level level, const char *fmt, va_list args) {
+  if (level == LIBBPF_DEBUG)
+    return 0;
+  return vfprintf(stderr, fmt, args);
+}
+
+int main(int argc, char **argv) {
+  int interval = 5, duration = 0;
+  bool verbose = false, cumulative = false;
+  int opt;
+  while ((opt = getopt(argc, argv, "i:d:cv")) != -1) {
+    switch (opt) {
+      case 'i': interval = atoi(optarg); break;
+      case 'd': duration = atoi(optarg); break;
+      case 'c': cumulative = true; break;
+      case 'v': verbose = true; break;
+      default:
+        fprintf(stderr, "Usage: %s [-i interval_s] [-d duration_s] [-c] [-v]\n", argv[0]);
+        return 1;
+    }
+  }
+  if (interval <= 0)
+    interval = 5;
+
+  libbpf_set_print(libbpf_print);
+  signal(SIGINT, sigh);
+  signal(SIGTERM, sigh);
+
+  reclaim_profiler_bpf *skel = reclaim_profiler_bpf__open_and_load();
+  if (!skel) {
+    fprintf(stderr, "failed to open/load BPF object (BTF or CO-RE relocation failure?)\n");
+    return 1;
+  }
+
+  // attach one by one, an inlined shrink_lruvec must not kill the whole tool
+  struct {
+    bpf_program *prog;
+    bpf_link **link;
+  } progs[] = {
+      {skel->progs.shrink_node_entry, &skel->links.shrink_node_entry},
+      {skel->progs.shrink_node_exit, &skel->links.shrink_node_exit},
+      {skel->progs.shrink_lruvec_entry, &skel->links.shrink_lruvec_entry},
+      {skel->progs.shrink_lruvec_exit, &skel->links.shrink_lruvec_exit},
+      {skel->progs.try_to_shrink_lruvec_entry, &skel->links.try_to_shrink_lruvec_entry},
+      {skel->progs.try_to_shrink_lruvec_exit, &skel->links.try_to_shrink_lruvec_exit},
+  };
+  int attached = 0;
+  for (auto &p : progs) {
+    *p.link = bpf_program__attach(p.prog);
+    if (!*p.link) {
+      fprintf(stderr, "skip %s: attach failed (%s)\n", bpf_program__name(p.prog), strerror(errno));
+      continue;
+    }
+    attached++;
+  }
+  if (!attached) {
+    fprintf(stderr, "no probe attached\n");
+    reclaim_profiler_bpf__destroy(skel);
+    return 1;
+  }
+
+  printf("Profiling reclaim, %d/%zu probes attached (Ctrl-C exit)…\n", attached,
+         sizeof(progs) / sizeof(progs[0]));
+
+  int cg_fd = bpf_map__fd(skel->maps.hist_cg);
+  int pid_fd = bpf_map__fd(skel->maps.hist_pid);
+  int lrugen_fd = bpf_map__fd(skel->maps.lrugen);
+  time_t start = time(nullptr);
+
+  while (running) {
+    for (int i = 0; i < interval && running; i++)
+      sleep(1);
+
+    time_t now = time(nullptr);
+    printf("\n---- %lds ----\n", (long)(now - start));
+    report_cgroups(cg_fd, verbose, !cumulative);
+    report_pids(pid_fd, verbose, !cumulative);
+    report_lrugen(lrugen_fd);
+    fflush(stdout);
+
+    if (duration && now - start >= duration)
+      break;
+  }
+
+  reclaim_profiler_bpf__destroy(skel);
+  return 0;
+}
@@ -0,0 +1,54 @@
+#ifndef RECLAIM_PROFILER_H
+#define RECLAIM_PROFILER_H
+
+/* shared between reclaim_profiler.bpf.c (vmlinux.h types) and the loader */
+#ifndef __VMLINUX_H__
+#include <linux/types.h>
+#endif
+
+#define HIST_SLOTS 32        /* log2(ns) buckets */
+#define NR_GENS 4            /* MAX_NR_GENS */
+#define NR_TYPES 2           /* ANON_AND_FILE */
+#define TASK_COMM_LEN 16
+
+enum reclaim_fn {
+    FN_SHRINK_NODE = 0,
+    FN_SHRINK_LRUVEC,
+    FN_TRY_TO_SHRINK_LRUVEC,
+    FN_NR,
+};
+
+/* latency / reclaimed histogram, per target cgroup or per reclaiming process */
+struct reclaim_hist {
+    __u64 slots[HIST_SLOTS];
+    __u64 count;
+    __u64 total_ns;
+    __u64 max_ns;
+    __u64 reclaimed;         /* sc->nr_reclaimed delta */
+    __u64 scanned;           /* sc->nr_scanned delta */
+    char comm[TASK_COMM_LEN];
+};
+
+struct cg_key {
+    __u64 cgid;              /* sc->target_mem_cgroup, 0 for global reclaim */
+    __u32 fn;
+    __u32 pad;
+};
+
+struct pid_key {
+    __u32 tgid;
+    __u32 fn;
+};
+
+/* last lrugen state seen by try_to_shrink_lruvec for one lruvec */
+struct lrugen_snap {
+    __u64 ts_ns;
+    __u64 cgid;              /* memcg owning the lruvec */
+    __u64 max_seq;
+    __u64 min_seq[NR_TYPES];
+    __s64 nr_pages[NR_GENS][NR_TYPES]; /* summed over zones, indexed by seq % NR_GENS */
+    __u32 node;
+    __u32 calls;
+};
+
+#endif // RECLAIM_PROFILER_H
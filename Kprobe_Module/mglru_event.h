@@ -0,0 +1,80 @@
+#ifndef MGLRU_EVENT_H
+#define MGLRU_EVENT_H
+
+/*
+ * Binary record format shared by try_to_shrink_lruvec_kprobe.ko and
+ * mglru_reader. Each CPU owns one ring exposed as
+ * /sys/kernel/debug/mglru_monitor/cpuN:
+ *
+ *   page 0       struct mglru_ring_hdr
+ *   page 1..     nr_records x struct mglru_event (power of two, no wrap split)
+ *
+ * Version 2 added the EVICT/REFAULT kinds and the mapping/index identity.
+ *
+ * The kernel advances head, the reader advances tail; both count records.
+ * head, dropped and nr_records are copies of the module's own state, writing
+ * them from user space changes nothing; a bad tail can only lose records.
+ */
+
+#include <linux/types.h>
+
+#define MGLRU_EVENT_VERSION 2
+#define MGLRU_DEBUGFS_DIR "mglru_monitor"
+
+enum mglru_event_kind {
+    MGLRU_EV_FOLIO = 1, /* folio found on a generation list */
+    MGLRU_EV_EVICT,     /* __remove_mapping succeeded inside shrink_folio_list */
+    MGLRU_EV_REFAULT,   /* workingset_refault, an evicted folio came back */
+};
+
+#define MGLRU_EVF_DIRTY      0x01
+#define MGLRU_EVF_WRITEBACK  0x02
+#define MGLRU_EVF_REFERENCED 0x04
+#define MGLRU_EVF_WORKINGSET 0x08
+#define MGLRU_EVF_SWAPBACKED 0x10
+
+/*
+ * mapping/index identify the data rather than the frame, so an eviction and
+ * the later refault (which lands on a different pfn) can be joined:
+ * file folios use the address_space pointer and page index, swap cache
+ * folios use mapping 0 and the swap entry value.
+ * EVICT/REFAULT records leave max_seq/min_seq/gen/call_id zero.
+ */
+struct mglru_event {
+    __u64 ts_ns;    /* local_clock(), the clock perf uses for sample time */
+    __u64 pfn;
+    __u64 max_seq;
+    __u64 min_seq;  /* of this type */
+    __u32 call_id;  /* try_to_shrink_lruvec call on this cpu */
+    __s32 refcount;
+    __u16 cpu;
+    __u8 kind;
+    __u8 gen;
+    __u8 type;      /* 0 anon, 1 file */
+    __u8 zone;
+    __u8 order;     /* folio order */
+    __u8 flags;     /* MGLRU_EVF_* */
+    __u64 mapping;
+    __u64 index;
+};
+
+struct mglru_ring_hdr {
+    __u64 head;       /* records written, kernel */
+    __u64 tail;       /* records consumed, reader */
+    __u64 dropped;    /* records lost because the ring was full */
+    __u32 nr_records;
+    __u32 rec_size;
+    __u32 version;
+    __u32 reserved;
+};
+
+/* mglru_reader output: this header followed by raw struct mglru_event */
+#define MGLRU_FILE_MAGIC "MGLRUEV1"
+
+struct mglru_file_hdr {
+    char magic[8];
+    __u32 version;
+    __u32 rec_size;
+};
+
+#endif // MGLRU_EVENT_H
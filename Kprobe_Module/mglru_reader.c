@@ -0,0 +1,197 @@
+/*
+ * mglru_reader.c  ——  drain the per-cpu rings of try_to_shrink_lruvec_kprobe.ko
+ *
+ *   gcc -O2 -Wall mglru_reader.c -o mglru_reader
+ *   sudo insmod try_to_shrink_lruvec_kprobe.ko
+ *   sudo ./mglru_reader [-o mglru_events.bin] [-i poll_ms]     Ctrl-C to stop
+ *   ./mglru_reader -p mglru_events.bin                          print as CSV
+ *
+ * Output is struct mglru_file_hdr followed by raw struct mglru_event records
+ * (64 bytes each, see mglru_event.h). reclaim_quality joins them with
+ * ibs_samples.csv.
+ */
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "mglru_event.h"
+
+#define DEBUGFS_ROOT "/sys/kernel/debug/" MGLRU_DEBUGFS_DIR
+
+static volatile int running = 1;
+static void sigh(int sig) {
+    (void)sig;
+    running = 0;
+}
+
+struct cpu_ring {
+    int cpu;
+    size_t map_sz;
+    struct mglru_ring_hdr *hdr;
+    struct mglru_event *recs;
+    uint64_t read;
+};
+
+static int map_ring(struct cpu_ring *r, int cpu) {
+    char path[128];
+    snprintf(path, sizeof(path), DEBUGFS_ROOT "/cpu%d", cpu);
+    int fd = open(path, O_RDWR);
+    if (fd < 0) return -1;
+
+    const size_t pg = sysconf(_SC_PAGESIZE);
+    struct mglru_ring_hdr *h = mmap(NULL, pg, PROT_READ, MAP_SHARED, fd, 0);
+    if (h == MAP_FAILED) {
+        perror("mmap ring header");
+        close(fd);
+        return -1;
+    }
+    if (h->version != MGLRU_EVENT_VERSION || h->rec_size != sizeof(struct mglru_event)) {
+        fprintf(stderr, "cpu%d: ring version %u / record size %u not supported\n", cpu,
+                h->version, h->rec_size);
+        munmap(h, pg);
+        close(fd);
+        return -1;
+    }
+    size_t map_sz = pg + (size_t)h->nr_records * h->rec_size;
+    map_sz = (map_sz + pg - 1) & ~(pg - 1);
+    munmap(h, pg);
+
+    void *p = mmap(NULL, map_sz, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (p == MAP_FAILED) {
+        perror("mmap ring");
+        return -1;
+    }
+    *r = (struct cpu_ring){.cpu = cpu, .map_sz = map_sz, .hdr = p,
+                           .recs = (struct mglru_event *)((char *)p + pg)};
+    return 0;
+}
+
+/* copy everything between tail and head to out, then release it */
+static void drain(struct cpu_ring *r, FILE *out) {
+    struct mglru_ring_hdr *h = r->hdr;
+    uint64_t head = __atomic_load_n(&h->head, __ATOMIC_ACQUIRE);
+    uint64_t tail = h->tail;
+    uint32_t mask = h->nr_records - 1;
+
+    while (tail != head) {
+        uint64_t idx = tail & mask;
+        uint64_t n = head - tail;
+        if (n > h->nr_records - idx) n = h->nr_records - idx; /* up to the ring end */
+        fwrite(&r->recs[idx], sizeof(struct mglru_event), n, out);
+        tail += n;
+        r->read += n;
+    }
+    __atomic_store_n(&h->tail, tail, __ATOMIC_RELEASE);
+}
+
+static int print_file(const char *path) {
+    FILE *f = fopen(path, "rb");
+    if (!f) {
+        perror("fopen");
+        return 1;
+    }
+    struct mglru_file_hdr fh;
+    if (fread(&fh, sizeof(fh), 1, f) != 1 || memcmp(fh.magic, MGLRU_FILE_MAGIC, 8) ||
+        fh.version != MGLRU_EVENT_VERSION || fh.rec_size != sizeof(struct mglru_event)) {
+        fprintf(stderr, "%s: not a version %d mglru event file\n", path, MGLRU_EVENT_VERSION);
+        fclose(f);
+        return 1;
+    }
+
+    static const char *kinds[] = {"?", "folio", "evict", "refault"};
+    puts("ts_ns,kind,cpu,call_id,pfn,max_seq,min_seq,gen,type,zone,order,refcount,flags,"
+         "mapping,index");
+    struct mglru_event ev;
+    while (fread(&ev, sizeof(ev), 1, f) == 1) {
+        printf("%llu,%s,%u,%u,0x%llx,%llu,%llu,%u,%s,%u,%u,%d,0x%x,0x%llx,0x%llx\n",
+               (unsigned long long)ev.ts_ns, ev.kind <= MGLRU_EV_REFAULT ? kinds[ev.kind] : "?",
+               ev.cpu, ev.call_id, (unsigned long long)ev.pfn, (unsigned long long)ev.max_seq,
+               (unsigned long long)ev.min_seq, ev.gen, ev.type ? "file" : "anon", ev.zone,
+               ev.order, ev.refcount, ev.flags, (unsigned long long)ev.mapping,
+               (unsigned long long)ev.index);
+    }
+    fclose(f);
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    const char *out_path = "mglru_events.bin";
+    int poll_ms = 10;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "o:i:p:h")) != -1) {
+        switch (opt) {
+        case 'o': out_path = optarg; break;
+        case 'i': poll_ms = atoi(optarg); break;
+        case 'p': return print_file(optarg);
+        default:
+            fprintf(stderr, "Usage: sudo %s [-o out.bin] [-i poll_ms] | %s -p out.bin\n",
+                    argv[0], argv[0]);
+            return 1;
+        }
+    }
+
+    signal(SIGINT, sigh);
+    signal(SIGTERM, sigh);
+
+    int ncpu = sysconf(_SC_NPROCESSORS_CONF);
+    struct cpu_ring *rings = calloc(ncpu, sizeof(*rings));
+    int nr = 0;
+    for (int cpu = 0; cpu < ncpu; cpu++)
+        if (map_ring(&rings[nr], cpu) == 0) nr++;
+    if (!nr) {
+        fprintf(stderr, "no rings under " DEBUGFS_ROOT ", is the module loaded?\n");
+        return 1;
+    }
+
+    FILE *out = fopen(out_path, "wb");
+    if (!out) {
+        perror("fopen output");
+        return 1;
+    }
+    struct mglru_file_hdr fh = {.version = MGLRU_EVENT_VERSION,
+                                .rec_size = sizeof(struct mglru_event)};
+    memcpy(fh.magic, MGLRU_FILE_MAGIC, 8);
+    fwrite(&fh, sizeof(fh), 1, out);
+
+    /* records written before we attached are not ours to judge, start clean */
+    uint64_t *dropped0 = calloc(nr, sizeof(*dropped0));
+    for (int i = 0; i < nr; i++) {
+        struct mglru_ring_hdr *h = rings[i].hdr;
+        __atomic_store_n(&h->tail, __atomic_load_n(&h->head, __ATOMIC_ACQUIRE), __ATOMIC_RELEASE);
+        dropped0[i] = h->dropped;
+    }
+
+    printf("Draining %d cpu rings into %s (Ctrl-C exit)\n", nr, out_path);
+    while (running) {
+        for (int i = 0; i < nr; i++) drain(&rings[i], out);
+        usleep(poll_ms * 1000);
+    }
+    for (int i = 0; i < nr; i++) drain(&rings[i], out);
+    fclose(out);
+
+    uint64_t total = 0, dropped = 0;
+    for (int i = 0; i < nr; i++) {
+        uint64_t d = rings[i].hdr->dropped - dropped0[i];
+        if (rings[i].read || d)
+            printf("cpu%-4d records %-10" PRIu64 " dropped %" PRIu64 "\n", rings[i].cpu,
+                   rings[i].read, d);
+        total += rings[i].read;
+        dropped += d;
+        munmap(rings[i].hdr, rings[i].map_sz);
+    }
+    printf("Total %" PRIu64 " records, %" PRIu64 " dropped, written into %s\n", total, dropped,
+           out_path);
+
+    free(dropped0);
+    free(rings);
+    return 0;
+}
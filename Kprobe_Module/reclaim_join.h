@@ -0,0 +1,164 @@
+/*
+ * reclaim_join.h  ——  the IBS hotness x MGLRU event join behind reclaim_quality
+ *
+ *   sample_index  IBS samples by pfn with sorted timestamps; a folio's
+ *                 hotness at time t is the number of samples on its frames
+ *                 in (t - window, t].
+ *   reclaim_join  fed every event in time order, counts hotness per
+ *                 generation age, hot folios in the oldest generation, hot
+ *                 evictions and refaults joined to the eviction before them.
+ */
+#ifndef RECLAIM_JOIN_H
+#define RECLAIM_JOIN_H
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <unordered_map>
+#include <vector>
+
+#include "mglru_event.h"
+
+#define PAGE_SHIFT 12
+#define MAX_GENS 4
+#define NR_BUCKETS 5
+#define MAX_FOLIO_PAGES 512 /* count samples on at most a PMD worth of frames */
+
+struct sample_index {
+  std::unordered_map<uint64_t, std::vector<uint64_t>> times; /* pfn -> sorted ts */
+  uint64_t samples = 0;
+  uint64_t first_ns = UINT64_MAX, last_ns = 0;
+
+  /* one ibs_samples.csv row: column 0 time_ns, column 6 phys_addr; rows without one are skipped */
+  void add_row(const char *p) {
+    uint64_t ts = strtoull(p, nullptr, 10);
+    for (int col = 0; col < 6 && p; col++) {
+      p = strchr(p, ',');
+      if (p) p++;
+    }
+    if (!p)
+      return;
+    uint64_t phys = strtoull(p, nullptr, 0);
+    if (!phys)
+      return;
+    times[phys >> PAGE_SHIFT].push_back(ts);
+    samples++;
+    first_ns = std::min(first_ns, ts);
+    last_ns = std::max(last_ns, ts);
+  }
+
+  /* per-cpu drains are only sorted per cpu */
+  void finish() {
+    for (auto &kv : times)
+      std::sort(kv.second.begin(), kv.second.end());
+  }
+
+  /* samples on [pfn, pfn + 2^order) in (t - window, t] */
+  uint64_t hotness(uint64_t pfn, unsigned order, uint64_t t, uint64_t window) const {
+    uint64_t nr = 1ULL << std::min(order, 9u), from = t > window ? t - window : 0, n = 0;
+    for (uint64_t p = pfn; p < pfn + std::min<uint64_t>(nr, MAX_FOLIO_PAGES); p++) {
+      auto it = times.find(p);
+      if (it == times.end())
+        continue;
+      const std::vector<uint64_t> &v = it->second;
+      n += std::upper_bound(v.begin(), v.end(), t) - std::upper_bound(v.begin(), v.end(), from);
+    }
+    return n;
+  }
+};
+
+struct data_id {
+  uint64_t mapping, index;
+  bool operator==(const data_id &o) const { return mapping == o.mapping && index == o.index; }
+};
+
+struct data_id_hash {
+  size_t operator()(const data_id &d) const {
+    return std::hash<uint64_t>()(d.mapping * 0x9e3779b97f4a7c15ULL ^ d.index);
+  }
+};
+
+struct eviction {
+  uint64_t ts_ns;
+  bool hot;
+};
+
+struct gen_stat {
+  uint64_t obs = 0, hot = 0, samples = 0;
+  uint64_t buckets[NR_BUCKETS] = {};
+};
+
+static inline int bucket_of(uint64_t n) {
+  if (n == 0) return 0;
+  if (n == 1) return 1;
+  if (n < 4) return 2;
+  if (n < 8) return 3;
+  return 4;
+}
+
+struct reclaim_join {
+  const sample_index &idx;
+  uint64_t window, hot_thr;
+
+  gen_stat gens[2][MAX_GENS]; /* [type][age] */
+  std::unordered_map<uint64_t, uint64_t> hot_oldest_pfns; /* pfn -> observations */
+  uint64_t folio_obs = 0, oldest_obs = 0, hot_oldest_obs = 0;
+  uint64_t evictions = 0, hot_evictions = 0, evict_type[2] = {}, hot_evict_type[2] = {};
+  uint64_t refaults = 0, refault_after_evict = 0, hot_refaulted = 0;
+  std::unordered_map<data_id, eviction, data_id_hash> evicted;
+  std::vector<uint64_t> refault_dist; /* eviction -> refault, ns */
+
+  reclaim_join(const sample_index &i, uint64_t w, uint64_t t) : idx(i), window(w), hot_thr(t) {}
+
+  void add(const mglru_event &ev) {
+    int type = ev.type ? 1 : 0;
+    switch (ev.kind) {
+      case MGLRU_EV_FOLIO: {
+        /* gen is seq % MAX_NR_GENS, age counts back from max_seq */
+        unsigned age = (unsigned)((ev.max_seq - ev.gen) % MAX_GENS);
+        bool oldest = ev.max_seq - age == ev.min_seq;
+        uint64_t h = idx.hotness(ev.pfn, ev.order, ev.ts_ns, window);
+        gen_stat &g = gens[type][age];
+        g.obs++;
+        g.samples += h;
+        g.buckets[bucket_of(h)]++;
+        folio_obs++;
+        if (h >= hot_thr)
+          g.hot++;
+        if (oldest) {
+          oldest_obs++;
+          if (h >= hot_thr) {
+            hot_oldest_obs++;
+            hot_oldest_pfns[ev.pfn]++;
+          }
+        }
+        break;
+      }
+      case MGLRU_EV_EVICT: {
+        bool hot = idx.hotness(ev.pfn, ev.order, ev.ts_ns, window) >= hot_thr;
+        evictions++;
+        evict_type[type]++;
+        if (hot) {
+          hot_evictions++;
+          hot_evict_type[type]++;
+        }
+        evicted[data_id{ev.mapping, ev.index}] = eviction{ev.ts_ns, hot};
+        break;
+      }
+      case MGLRU_EV_REFAULT: {
+        refaults++;
+        auto it = evicted.find(data_id{ev.mapping, ev.index});
+        if (it == evicted.end())
+          break; /* evicted before the trace started */
+        refault_after_evict++;
+        hot_refaulted += it->second.hot;
+        refault_dist.push_back(ev.ts_ns - it->second.ts_ns);
+        evicted.erase(it);
+        break;
+      }
+    }
+  }
+};
+
+#endif // RECLAIM_JOIN_H
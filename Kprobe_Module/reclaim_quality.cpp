@@ -0,0 +1,198 @@
+/*
+ * reclaim_quality.cpp  ——  join MGLRU reclaim events with IBS hotness
+ *
+ *   ./reclaim_quality [-w window_ms] [-t hot_samples] [-l label] [-a summary.csv]
+ *                     <mglru_events.bin> <ibs_samples.csv>
+ *
+ *   mglru_events.bin comes from mglru_reader, ibs_samples.csv from ibs_reader,
+ *   recorded at the same time on the same boot (both use the local_clock
+ *   timeline; a recording made with IBS_CLOCK=monotonic, as noted in
+ *   ibs_samples.csv.clock, is refused). IBS samples are indexed by pfn with
+ *   sorted timestamps; a folio's hotness at time t is the number of samples on
+ *   its frames in (t - window, t]. The join itself is in reclaim_join.h.
+ *
+ *   Reported:
+ *     - hotness distribution of folios per generation age (0 = youngest),
+ *     - hot folios sitting in the oldest generation (next to be evicted),
+ *     - evictions that were hot just before __remove_mapping,
+ *     - refault-after-eviction rate, joined on mapping/index or swap entry.
+ *
+ *   -a appends one CSV row per run so MGLRU tunings can be compared run over run.
+ */
+#include <algorithm>
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+#include "mglru_event.h"
+#include "reclaim_join.h"
+
+static const char *bucket_names[NR_BUCKETS] = {"0", "1", "2-3", "4-7", "8+"};
+
+static bool load_samples(const char *path, sample_index &idx) {
+  std::ifstream in(path);
+  if (!in) {
+    perror(path);
+    return false;
+  }
+  std::string line;
+  std::getline(in, line); /* header */
+  while (std::getline(in, line))
+    idx.add_row(line.c_str());
+  idx.finish();
+  return true;
+}
+
+/* ibs_reader notes its time_ns clock in <csv>.clock; no file means an older perf-clock run */
+static bool samples_on_perf_clock(const char *path) {
+  std::ifstream in(std::string(path) + ".clock");
+  std::string clock;
+  if (!in || !std::getline(in, clock) || clock == "perf")
+    return true;
+  fprintf(stderr, "%s: time_ns is on the %s clock, record with the default perf clock to join "
+                  "with local_clock() events\n", path, clock.c_str());
+  return false;
+}
+
+static bool load_events(const char *path, std::vector<mglru_event> &evs) {
+  FILE *f = fopen(path, "rb");
+  if (!f) {
+    perror(path);
+    return false;
+  }
+  mglru_file_hdr fh;
+  if (fread(&fh, sizeof(fh), 1, f) != 1 || memcmp(fh.magic, MGLRU_FILE_MAGIC, 8) ||
+      fh.version != MGLRU_EVENT_VERSION || fh.rec_size != sizeof(mglru_event)) {
+    fprintf(stderr, "%s: not a version %d mglru event file\n", path, MGLRU_EVENT_VERSION);
+    fclose(f);
+    return false;
+  }
+  mglru_event buf[4096];
+  size_t n;
+  while ((n = fread(buf, sizeof(buf[0]), 4096, f)) > 0)
+    evs.insert(evs.end(), buf, buf + n);
+  fclose(f);
+  std::stable_sort(evs.begin(), evs.end(),
+                   [](const mglru_event &a, const mglru_event &b) { return a.ts_ns < b.ts_ns; });
+  return true;
+}
+
+static double pct(uint64_t a, uint64_t b) { return b ? 100.0 * a / b : 0.0; }
+
+static double percentile_ms(std::vector<uint64_t> &v, double p) {
+  if (v.empty())
+    return 0;
+  size_t i = std::min(v.size() - 1, (size_t)(p * v.size()));
+  std::nth_element(v.begin(), v.begin() + i, v.end());
+  return v[i] / 1e6;
+}
+
+int main(int argc, char **argv) {
+  uint64_t window_ms = 1000, hot_thr = 2;
+  const char *label = "run", *summary_path = nullptr;
+  int opt;
+  while ((opt = getopt(argc, argv, "w:t:l:a:")) != -1) {
+    switch (opt) {
+      case 'w': window_ms = strtoull(optarg, nullptr, 10); break;
+      case 't': hot_thr = strtoull(optarg, nullptr, 10); break;
+      case 'l': label = optarg; break;
+      case 'a': summary_path = optarg; break;
+      default: optind = argc + 1; break;
+    }
+  }
+  if (optind + 2 != argc || !hot_thr) {
+    fprintf(stderr,
+            "Usage: %s [-w window_ms] [-t hot_samples] [-l label] [-a summary.csv] "
+            "<mglru_events.bin> <ibs_samples.csv>\n",
+            argv[0]);
+    return 1;
+  }
+  const uint64_t window = window_ms * 1000000ULL;
+
+  std::vector<mglru_event> evs;
+  sample_index idx;
+  if (!samples_on_perf_clock(argv[optind + 1]) || !load_events(argv[optind], evs) ||
+      !load_samples(argv[optind + 1], idx))
+    return 1;
+  if (evs.empty() || !idx.samples) {
+    fprintf(stderr, "nothing to join: %zu events, %" PRIu64 " samples\n", evs.size(), idx.samples);
+    return 1;
+  }
+  if (evs.back().ts_ns < idx.first_ns || evs.front().ts_ns > idx.last_ns)
+    fprintf(stderr, "warning: event and sample time ranges do not overlap, same boot?\n");
+
+  reclaim_join j(idx, window, hot_thr);
+  for (const mglru_event &ev : evs)
+    j.add(ev);
+
+  printf("== inputs ==\n");
+  printf("  ibs samples %" PRIu64 " on %zu pfns, mglru events %zu\n", idx.samples, idx.times.size(),
+         evs.size());
+  printf("  hot = >= %" PRIu64 " samples in the %" PRIu64 " ms before the event\n", hot_thr,
+         window_ms);
+
+  printf("== hotness per generation age (folio observations, 0 = youngest) ==\n");
+  printf("  %-5s %-4s %10s", "type", "age", "obs");
+  for (int b = 0; b < NR_BUCKETS; b++)
+    printf(" %8s", bucket_names[b]);
+  printf(" %8s %10s\n", "hot%", "samples/f");
+  for (int type = 0; type < 2; type++) {
+    for (int age = 0; age < MAX_GENS; age++) {
+      const gen_stat &g = j.gens[type][age];
+      if (!g.obs)
+        continue;
+      printf("  %-5s %-4d %10" PRIu64, type ? "file" : "anon", age, g.obs);
+      for (int b = 0; b < NR_BUCKETS; b++)
+        printf(" %8" PRIu64, g.buckets[b]);
+      printf(" %7.2f%% %10.3f\n", pct(g.hot, g.obs), (double)g.samples / g.obs);
+    }
+  }
+
+  printf("== oldest generation ==\n");
+  printf("  observations %" PRIu64 ", hot %" PRIu64 " (%.2f%%), distinct hot pfns %zu\n",
+         j.oldest_obs, j.hot_oldest_obs, pct(j.hot_oldest_obs, j.oldest_obs),
+         j.hot_oldest_pfns.size());
+
+  printf("== evictions ==\n");
+  printf("  evicted %" PRIu64 " (anon %" PRIu64 ", file %" PRIu64 "), hot %" PRIu64 " (%.2f%%)\n",
+         j.evictions, j.evict_type[0], j.evict_type[1], j.hot_evictions,
+         pct(j.hot_evictions, j.evictions));
+  printf("  hot anon %" PRIu64 ", hot file %" PRIu64 "\n", j.hot_evict_type[0], j.hot_evict_type[1]);
+
+  double p50 = percentile_ms(j.refault_dist, 0.5), p90 = percentile_ms(j.refault_dist, 0.9);
+  printf("== refaults ==\n");
+  printf("  refaults %" PRIu64 ", after an eviction in this trace %" PRIu64 "\n", j.refaults,
+         j.refault_after_evict);
+  printf("  refault-after-eviction rate %.2f%%, of hot evictions %.2f%%\n",
+         pct(j.refault_after_evict, j.evictions), pct(j.hot_refaulted, j.hot_evictions));
+  printf("  eviction -> refault p50 %.1f ms, p90 %.1f ms\n", p50, p90);
+
+  if (summary_path) {
+    bool fresh = access(summary_path, F_OK) != 0;
+    FILE *s = fopen(summary_path, "a");
+    if (!s) {
+      perror(summary_path);
+      return 1;
+    }
+    if (fresh)
+      fprintf(s, "label,window_ms,hot_samples,ibs_samples,folio_obs,oldest_obs,hot_oldest_obs,"
+                 "hot_oldest_pct,hot_oldest_pfns,evictions,hot_evictions,hot_evict_pct,"
+                 "refaults_after_evict,refault_pct,hot_refault_pct,refault_p50_ms,refault_p90_ms\n");
+    fprintf(s,
+            "%s,%" PRIu64 ",%" PRIu64 ",%" PRIu64 ",%" PRIu64 ",%" PRIu64 ",%" PRIu64
+            ",%.3f,%zu,%" PRIu64 ",%" PRIu64 ",%.3f,%" PRIu64 ",%.3f,%.3f,%.3f,%.3f\n",
+            label, window_ms, hot_thr, idx.samples, j.folio_obs, j.oldest_obs, j.hot_oldest_obs,
+            pct(j.hot_oldest_obs, j.oldest_obs), j.hot_oldest_pfns.size(), j.evictions,
+            j.hot_evictions, pct(j.hot_evictions, j.evictions), j.refault_after_evict,
+            pct(j.refault_after_evict, j.evictions), pct(j.hot_refaulted, j.hot_evictions), p50,
+            p90);
+    fclose(s);
+    printf("Appended summary row \"%s\" to %s\n", label, summary_path);
+  }
+  return 0;
+}
@@ -0,0 +1,110 @@
+/*
+ * reclaim_quality_test.cpp  ——  the hotness x MGLRU event join, called directly
+ *
+ *   make test_reclaim_quality
+ *
+ *   Feeds ibs_samples.csv rows into a sample_index and events into a
+ *   reclaim_join (reclaim_join.h) and checks hotness, generation ages and the
+ *   eviction / refault bookkeeping against known answers.
+ */
+#include <assert.h>
+#include <stdio.h>
+
+#include "reclaim_join.h"
+
+#define MS 1000000ULL
+
+static mglru_event folio(uint64_t ts, uint64_t pfn, uint8_t gen) {
+  mglru_event ev = {};
+  ev.ts_ns = ts;
+  ev.pfn = pfn;
+  ev.kind = MGLRU_EV_FOLIO;
+  ev.max_seq = 7;
+  ev.min_seq = 4;
+  ev.gen = gen;
+  ev.type = 1;
+  return ev;
+}
+
+static mglru_event ident(uint8_t kind, uint64_t ts, uint64_t pfn, uint64_t mapping, uint64_t index) {
+  mglru_event ev = {};
+  ev.ts_ns = ts;
+  ev.pfn = pfn;
+  ev.kind = kind;
+  ev.type = 1;
+  ev.mapping = mapping;
+  ev.index = index;
+  return ev;
+}
+
+int main() {
+  /* pfn 0x100 is sampled 3 times right before it is seen and evicted, 0x200 never */
+  static const char *rows[] = {
+      "990000000,1,1,1,0x1,0x7f0000000000,0x100010",
+      "980000000,1,1,0,0x1,0x7f0000000000,0x100020", /* other cpu, out of order */
+      "995000000,1,1,0,0x1,0x7f0000000000,0x100030",
+      "995000000,1,1,0,0x1,0x7f0000001000,0x0",      /* no phys_addr */
+      "1200000000,1,1,0,0x1,0x7f0000002000,0x500000", /* unrelated page */
+      "1300000000,1,1,0,0x1,0x7f0000003000,0x101000", /* second frame of an order-1 folio */
+      "1,2,3",                                        /* short row */
+  };
+  sample_index idx;
+  for (const char *r : rows)
+    idx.add_row(r);
+  idx.finish();
+  assert(idx.samples == 5);
+  assert(idx.first_ns == 980 * MS && idx.last_ns == 1300 * MS);
+
+  static const struct {
+    uint64_t pfn;
+    unsigned order;
+    uint64_t t, window, expect;
+  } hot_cases[] = {
+      {0x100, 0, 1000 * MS, 100 * MS, 3},
+      {0x100, 0, 1000 * MS, 15 * MS, 2},  /* (985, 1000]: 980 is out */
+      {0x100, 0, 990 * MS, 100 * MS, 2},  /* t itself counts, 995 is later */
+      {0x100, 0, 900 * MS, 100 * MS, 0},
+      {0x200, 0, 1000 * MS, 100 * MS, 0},
+      {0x100, 1, 1300 * MS, 400 * MS, 4}, /* both frames of the folio */
+      {0x100, 0, 1300 * MS, 400 * MS, 3},
+      {0x100, 20, 1000 * MS, 100 * MS, 3}, /* order past a PMD is capped */
+  };
+  for (const auto &c : hot_cases)
+    assert(idx.hotness(c.pfn, c.order, c.t, c.window) == c.expect);
+
+  static const struct {
+    uint64_t n;
+    int bucket;
+  } bucket_cases[] = {{0, 0}, {1, 1}, {2, 2}, {3, 2}, {4, 3}, {7, 3}, {8, 4}, {1000, 4}};
+  for (const auto &c : bucket_cases)
+    assert(bucket_of(c.n) == c.bucket);
+
+  /* in time order, as reclaim_quality sorts them */
+  const mglru_event evs[] = {
+      folio(1000 * MS, 0x100, 0),                           /* gen 0 = seq 4: oldest */
+      folio(1000 * MS, 0x200, 3),                           /* gen 3 = seq 7: youngest */
+      ident(MGLRU_EV_EVICT, 1010 * MS, 0x100, 0xa000, 1),   /* hot */
+      ident(MGLRU_EV_EVICT, 1020 * MS, 0x200, 0xa000, 2),   /* cold, never comes back */
+      ident(MGLRU_EV_REFAULT, 1500 * MS, 0x300, 0xa000, 1), /* refault of the hot eviction */
+      ident(MGLRU_EV_REFAULT, 1600 * MS, 0x400, 0xb000, 9), /* evicted before the trace */
+      ident(MGLRU_EV_REFAULT, 1700 * MS, 0x300, 0xa000, 1), /* already joined once */
+  };
+  reclaim_join j(idx, 100 * MS, 2);
+  for (const mglru_event &ev : evs)
+    j.add(ev);
+
+  assert(j.folio_obs == 2);
+  /* age counts back from max_seq: gen 3 is age 0, gen 0 age 3 */
+  assert(j.gens[1][0].obs == 1 && j.gens[1][0].hot == 0 && j.gens[1][0].buckets[0] == 1);
+  assert(j.gens[1][3].obs == 1 && j.gens[1][3].hot == 1 && j.gens[1][3].samples == 3);
+  assert(j.gens[1][3].buckets[2] == 1);
+  assert(j.oldest_obs == 1 && j.hot_oldest_obs == 1 && j.hot_oldest_pfns.size() == 1);
+  assert(j.evictions == 2 && j.hot_evictions == 1);
+  assert(j.evict_type[1] == 2 && j.hot_evict_type[1] == 1 && j.evict_type[0] == 0);
+  assert(j.refaults == 3 && j.refault_after_evict == 1 && j.hot_refaulted == 1);
+  assert(j.refault_dist.size() == 1 && j.refault_dist[0] == 490 * MS);
+  assert(j.evicted.size() == 1); /* the cold one is still out */
+
+  printf("All tests passed!\n");
+  return 0;
+}
@@ -5,87 +5,422 @@
 #include <linux/mmzone.h>
 #include <linux/mm_inline.h>
 #include <linux/sched.h>
+#include <linux/sched/clock.h>
 #include <linux/list.h>
 #include <linux/mm.h>
 #include <linux/page-flags.h>
 #include <linux/pgtable.h>
+#include <linux/percpu.h>
+#include <linux/vmalloc.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <linux/log2.h>
+#include <linux/swap.h>
 
+#include "mglru_event.h"
 
+/*
+ * Every try_to_shrink_lruvec call walks the MGLRU generation lists and writes
+ * one fixed-size struct mglru_event per folio into a per-CPU ring that user
+ * space mmaps from /sys/kernel/debug/mglru_monitor/cpuN (see mglru_reader.c).
+ * A full ring drops the record and bumps the drop counter instead of
+ * blocking reclaim. /sys/kernel/debug/mglru_monitor/stats shows the counters.
+ * The walk holds lruvec->lru_lock (trylock, a contended call is skipped) and
+ * records at most max_folios folios per list.
+ *
+ * A kretprobe on __remove_mapping adds an EVICT record for every folio reclaim
+ * actually drops, and a kprobe on workingset_refault a REFAULT record when one
+ * comes back, so reclaim_quality can tell hot evictions and refaults apart.
+ * __remove_mapping also runs outside reclaim (remove_mapping() for splice page
+ * stealing, invalidation), so EVICT is only emitted while the task is inside
+ * shrink_folio_list, tracked by a kretprobe there.
+ * All three probes run in process context (reclaim, faults, readahead), so the
+ * ring keeps one producer per cpu.
+ *
+ * Needs Linux 6.6 or later (struct lru_gen_folio, folio->swap).
+ */
+
+static unsigned int ring_pages = 64;
+module_param(ring_pages, uint, 0444);
+MODULE_PARM_DESC(ring_pages, "data pages per cpu ring, power of two (default 64)");
+
+#define MAX_FOLIOS_LIMIT 256
+
+static unsigned int max_folios = 50;
+
+/* the walk runs under lru_lock with irqs off, so it has to stay short */
+static int max_folios_set(const char *val, const struct kernel_param *param)
+{
+    unsigned int n;
+    int ret = kstrtouint(val, 0, &n);
+
+    if (ret)
+        return ret;
+    if (!n || n > MAX_FOLIOS_LIMIT)
+        return -EINVAL;
+    return param_set_uint(val, param);
+}
+
+static const struct kernel_param_ops max_folios_ops = {
+    .set = max_folios_set,
+    .get = param_get_uint,
+};
+module_param_cb(max_folios, &max_folios_ops, &max_folios, 0644);
+MODULE_PARM_DESC(max_folios, "folios recorded per generation list per call, 1..256 (default 50)");
+
+/*
+ * The header page is mapped writable by the reader, so the producer keeps its
+ * own copy of head, the size and the drop count and only publishes them there;
+ * the one thing it reads back is tail, and only to decide whether there is room.
+ */
+struct mglru_cpu_ring {
+    void *vmem;                  /* vmalloc_user: header page + records */
+    size_t size;
+    struct mglru_ring_hdr *hdr;
+    struct mglru_event *recs;
+    u64 head;
+    u64 dropped;
+    u32 nr_records;              /* power of two */
+    u32 call_id;
+};
+
+static DEFINE_PER_CPU(struct mglru_cpu_ring, rings);
+static struct dentry *debugfs_dir;
 static struct kprobe kp;
+static struct kprobe refault_kp;
+static struct kretprobe evict_krp;
+static struct kretprobe shrink_krp;
+static bool refault_on, evict_on;
+
+/*
+ * Tasks currently inside shrink_folio_list. Per task, not per cpu: reclaim can
+ * sleep in writeback and continue on another cpu while something else runs here.
+ */
+#define RECLAIM_SLOTS 128
+static struct task_struct *reclaimers[RECLAIM_SLOTS];
+static atomic64_t evict_skipped, reclaim_overflow, walk_busy;
+
+/* producer side, runs with preemption disabled (kprobe handler) */
+static void ring_put(struct mglru_cpu_ring *r, const struct mglru_event *ev)
+{
+    struct mglru_ring_hdr *h = r->hdr;
+    u64 head = r->head;
+    u64 tail = smp_load_acquire(&h->tail);
+
+    /* a tail ahead of head wraps to a huge distance and counts as full too */
+    if (head - tail >= r->nr_records) {
+        r->dropped++;
+        WRITE_ONCE(h->dropped, r->dropped);
+        return;
+    }
+
+    r->recs[head & (r->nr_records - 1)] = *ev;
+    r->head = head + 1;
+    smp_store_release(&h->head, r->head);
+}
+
+static u8 folio_event_flags(struct folio *folio)
+{
+    u8 flags = 0;
+
+    if (folio_test_dirty(folio))
+        flags |= MGLRU_EVF_DIRTY;
+    if (folio_test_writeback(folio))
+        flags |= MGLRU_EVF_WRITEBACK;
+    if (folio_test_referenced(folio))
+        flags |= MGLRU_EVF_REFERENCED;
+    if (folio_test_workingset(folio))
+        flags |= MGLRU_EVF_WORKINGSET;
+    if (folio_test_swapbacked(folio))
+        flags |= MGLRU_EVF_SWAPBACKED;
+    return flags;
+}
+
+/* which data the folio holds, stable across eviction and refault */
+static void folio_identity(struct folio *folio, struct mglru_event *ev)
+{
+    if (folio_test_swapcache(folio)) {
+        ev->mapping = 0;
+        ev->index = folio->swap.val;
+    } else {
+        ev->mapping = (unsigned long)READ_ONCE(folio->mapping);
+        ev->index = folio->index;
+    }
+}
+
+static void folio_fill(struct folio *folio, struct mglru_event *ev)
+{
+    ev->pfn = folio_pfn(folio);
+    ev->refcount = folio_ref_count(folio);
+    ev->type = folio_is_file_lru(folio);
+    ev->zone = folio_zonenum(folio);
+    ev->order = folio_order(folio);
+    ev->flags = folio_event_flags(folio);
+    folio_identity(folio, ev);
+}
 
 static int handler_pre(struct kprobe *p, struct pt_regs *regs)
 {
     struct lruvec *lruvec = NULL;
     struct lru_gen_folio *lrugen = NULL;
-    int gen, type, zone, page_refcount;
+    struct mglru_cpu_ring *ring;
+    struct mglru_event ev = {0};
+    unsigned long irqflags;
+    unsigned int limit;
+    int gen, type, zone;
 
     lruvec = (struct lruvec *)regs->di;
 
-    if (!lruvec) {
-        pr_warn("lruvec is NULL\n");
+    if (!lruvec)
         return 0;
-    }
 
     lrugen = &lruvec->lrugen;
-    if (!lrugen) {
-        pr_warn("lrugen is NULL\n");
+    ring = this_cpu_ptr(&rings);
+    if (!ring->hdr)
+        return 0;
+
+    /*
+     * Folios move between generations under lru_lock; walking without it can
+     * follow a folio onto another list. Skip the call rather than spin.
+     */
+    if (!spin_trylock_irqsave(&lruvec->lru_lock, irqflags)) {
+        atomic64_inc(&walk_busy);
         return 0;
     }
 
-    pr_info("[KPROBE] try_to_shrink_lruvec called\n");
-    pr_info("[KPROBE] max_seq: %lu\n", lrugen->max_seq);
+    limit = min(READ_ONCE(max_folios), ring->nr_records);
+    ev.kind = MGLRU_EV_FOLIO;
+    ev.cpu = smp_processor_id();
+    ev.call_id = ++ring->call_id;
+    ev.max_seq = READ_ONCE(lrugen->max_seq);
 
     for (gen = 0; gen < MAX_NR_GENS; gen++) {
         for (type = 0; type < ANON_AND_FILE; type++) {
+            ev.min_seq = READ_ONCE(lrugen->min_seq[type]);
+
             for (zone = 0; zone < MAX_NR_ZONES; zone++) {
                 struct list_head *head;
                 struct folio *folio;
-                struct page *page;
-                long count = 0;
+                unsigned int count = 0;
 
                 head = &lrugen->folios[gen][type][zone];
 
-                if (!head || list_empty(head))
+                if (list_empty(head))
                     continue;
 
-                pr_info("Generation %d, type %s, zone %d:\n", gen,
-                        (type == 0 ? "anon" : "file"), zone);
-
                 list_for_each_entry(folio, head, lru) {
-                    if (!folio) {
-                        pr_warn("NULL folio in list\n");
-                        break;
-                    }
-                    
-                    page = &folio->page;
-                    page_refcount = page_ref_count(page);
-                    unsigned long pfn = page_to_pfn(page);
-                    unsigned long long page_phys_addr = pfn << PAGE_SHIFT;
-
-                    // bool active = PageActive(page);
-                    // bool referenced = PageReferenced(page);
-                    bool dirty = PageDirty(page);
-                    // bool swapbacked = PageSwapBacked(page);
-                    bool writeback = PageWriteback(page);
-                    // bool unevictable = PageUnevictable(page);
-
-                    pr_info("(folio: %px) (page addr: %px) (page phys addr: %px) (page ref count: %d)\n", folio, page, page_phys_addr, page_refcount);
-                    count++;
-                    if (count > 50) {
-                        pr_info("  ... more pages omitted\n");
+                    if (count++ >= limit)
                         break;
-                    }
+
+                    ev.ts_ns = local_clock();
+                    folio_fill(folio, &ev);
+                    ev.gen = gen;
+                    ev.type = type;
+                    ev.zone = zone;
+                    ring_put(ring, &ev);
                 }
             }
         }
     }
 
+    spin_unlock_irqrestore(&lruvec->lru_lock, irqflags);
+    return 0;
+}
+
+static int shrink_entry(struct kretprobe_instance *ri, struct pt_regs *regs)
+{
+    int i;
+
+    for (i = 0; i < RECLAIM_SLOTS; i++) {
+        if (!cmpxchg(&reclaimers[i], NULL, current)) {
+            *(int *)ri->data = i;
+            return 0;
+        }
+    }
+    atomic64_inc(&reclaim_overflow); /* this call's evictions go unrecorded */
+    return 1;
+}
+
+static int shrink_ret(struct kretprobe_instance *ri, struct pt_regs *regs)
+{
+    WRITE_ONCE(reclaimers[*(int *)ri->data], NULL);
+    return 0;
+}
+
+static bool in_reclaim(void)
+{
+    int i;
+
+    for (i = 0; i < RECLAIM_SLOTS; i++)
+        if (READ_ONCE(reclaimers[i]) == current)
+            return true;
+    return false;
+}
+
+/*
+ * __remove_mapping(mapping, folio, reclaimed, target_memcg) returns 1 once the
+ * folio is out of the page/swap cache. mapping and swap entry are cleared by
+ * then, so the record is built on entry and only emitted on success.
+ */
+static int evict_entry(struct kretprobe_instance *ri, struct pt_regs *regs)
+{
+    struct mglru_event *ev = (struct mglru_event *)ri->data;
+    struct folio *folio = (struct folio *)regs_get_kernel_argument(regs, 1);
+
+    if (!folio)
+        return 1; /* no return handler */
+    if (!in_reclaim()) {
+        atomic64_inc(&evict_skipped);
+        return 1;
+    }
+
+    memset(ev, 0, sizeof(*ev));
+    ev->kind = MGLRU_EV_EVICT;
+    folio_fill(folio, ev);
+    return 0;
+}
+
+static int evict_ret(struct kretprobe_instance *ri, struct pt_regs *regs)
+{
+    struct mglru_event *ev = (struct mglru_event *)ri->data;
+    struct mglru_cpu_ring *ring = this_cpu_ptr(&rings);
+
+    if (!regs_return_value(regs) || !ring->hdr)
+        return 0;
+
+    ev->ts_ns = local_clock();
+    ev->cpu = smp_processor_id();
+    ring_put(ring, ev);
+    return 0;
+}
+
+/* workingset_refault(folio, shadow): folio is the new copy, already in the cache */
+static int refault_pre(struct kprobe *p, struct pt_regs *regs)
+{
+    struct folio *folio = (struct folio *)regs_get_kernel_argument(regs, 0);
+    struct mglru_cpu_ring *ring = this_cpu_ptr(&rings);
+    struct mglru_event ev = {0};
+
+    if (!folio || !ring->hdr)
+        return 0;
+
+    ev.kind = MGLRU_EV_REFAULT;
+    ev.ts_ns = local_clock();
+    ev.cpu = smp_processor_id();
+    folio_fill(folio, &ev);
+    ring_put(ring, &ev);
+    return 0;
+}
+
+static int ring_mmap(struct file *file, struct vm_area_struct *vma)
+{
+    long cpu = (long)file->private_data;
+    struct mglru_cpu_ring *r = per_cpu_ptr(&rings, cpu);
+    unsigned long len = vma->vm_end - vma->vm_start;
+
+    if (vma->vm_pgoff || len > r->size)
+        return -EINVAL;
+
+    return remap_vmalloc_range(vma, r->vmem, 0);
+}
+
+static const struct file_operations ring_fops = {
+    .owner = THIS_MODULE,
+    .open = simple_open,
+    .mmap = ring_mmap,
+    .llseek = noop_llseek,
+};
+
+static int stats_show(struct seq_file *m, void *v)
+{
+    int cpu;
+
+    seq_printf(m, "kprobe nmissed %lu, walks skipped on a busy lru_lock %lld\n", kp.nmissed,
+               (long long)atomic64_read(&walk_busy));
+    if (evict_on) {
+        seq_printf(m, "evict kretprobe nmissed %d kprobe nmissed %lu\n", evict_krp.nmissed,
+                   evict_krp.kp.nmissed);
+        seq_printf(m, "%s kretprobe nmissed %d, table full %lld, removals outside reclaim %lld\n",
+                   shrink_krp.kp.symbol_name, shrink_krp.nmissed,
+                   (long long)atomic64_read(&reclaim_overflow),
+                   (long long)atomic64_read(&evict_skipped));
+    }
+    if (refault_on)
+        seq_printf(m, "refault kprobe nmissed %lu\n", refault_kp.nmissed);
+    seq_puts(m, "cpu head tail dropped\n");
+    for_each_possible_cpu(cpu) {
+        struct mglru_cpu_ring *r = per_cpu_ptr(&rings, cpu);
+
+        if (!r->hdr)
+            continue;
+        seq_printf(m, "%d %llu %llu %llu\n", cpu, READ_ONCE(r->head),
+                   READ_ONCE(r->hdr->tail), READ_ONCE(r->dropped));
+    }
+    return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(stats);
+
+static void free_rings(void)
+{
+    int cpu;
+
+    for_each_possible_cpu(cpu) {
+        struct mglru_cpu_ring *r = per_cpu_ptr(&rings, cpu);
+
+        vfree(r->vmem);
+        memset(r, 0, sizeof(*r));
+    }
+}
+
+static int alloc_rings(void)
+{
+    size_t data_sz = (size_t)ring_pages * PAGE_SIZE;
+    int cpu;
+
+    for_each_possible_cpu(cpu) {
+        struct mglru_cpu_ring *r = per_cpu_ptr(&rings, cpu);
+        struct mglru_ring_hdr *h;
+
+        r->size = PAGE_SIZE + data_sz;
+        r->vmem = vmalloc_user(r->size);
+        if (!r->vmem)
+            return -ENOMEM;
+
+        h = r->vmem;
+        /* keep the record count a power of two so head/tail can be masked */
+        r->nr_records = rounddown_pow_of_two(data_sz / sizeof(struct mglru_event));
+        h->nr_records = r->nr_records;
+        h->rec_size = sizeof(struct mglru_event);
+        h->version = MGLRU_EVENT_VERSION;
+        r->recs = r->vmem + PAGE_SIZE;
+        r->hdr = h;
+    }
     return 0;
 }
 
 static int __init mglru_monitor_init(void)
 {
-    int ret;
+    int ret, cpu;
+
+    if (!ring_pages || !is_power_of_2(ring_pages)) {
+        pr_err("ring_pages must be a power of two\n");
+        return -EINVAL;
+    }
+
+    ret = alloc_rings();
+    if (ret) {
+        pr_err("ring allocation failed\n");
+        goto err_free;
+    }
+
+    debugfs_dir = debugfs_create_dir(MGLRU_DEBUGFS_DIR, NULL);
+    for_each_possible_cpu(cpu) {
+        char name[16];
+
+        snprintf(name, sizeof(name), "cpu%d", cpu);
+        debugfs_create_file(name, 0600, debugfs_dir, (void *)(long)cpu, &ring_fops);
+    }
+    debugfs_create_file("stats", 0400, debugfs_dir, NULL, &stats_fops);
 
     kp.symbol_name = "try_to_shrink_lruvec";
     kp.pre_handler = handler_pre;
@@ -93,16 +428,60 @@ static int __init mglru_monitor_init(void)
     ret = register_kprobe(&kp);
     if (ret < 0) {
         pr_err("register_kprobe failed, returned %d\n", ret);
-        return ret;
+        goto err_debugfs;
     }
 
-    pr_info("MGLRU monitor module loaded.\n");
+    /* eviction / refault tracking is best effort, e.g. __remove_mapping may be inlined */
+    shrink_krp.kp.symbol_name = "shrink_folio_list";
+    shrink_krp.entry_handler = shrink_entry;
+    shrink_krp.handler = shrink_ret;
+    shrink_krp.data_size = sizeof(int);
+    shrink_krp.maxactive = 2 * num_possible_cpus();
+    ret = register_kretprobe(&shrink_krp);
+    if (ret < 0) {
+        pr_warn("register_kretprobe shrink_folio_list failed (%d), no EVICT records\n", ret);
+    } else {
+        evict_krp.kp.symbol_name = "__remove_mapping";
+        evict_krp.entry_handler = evict_entry;
+        evict_krp.handler = evict_ret;
+        evict_krp.data_size = sizeof(struct mglru_event);
+        evict_krp.maxactive = 2 * num_possible_cpus();
+        ret = register_kretprobe(&evict_krp);
+        if (ret < 0) {
+            pr_warn("register_kretprobe __remove_mapping failed (%d), no EVICT records\n", ret);
+            unregister_kretprobe(&shrink_krp);
+        }
+    }
+    evict_on = ret == 0;
+
+    refault_kp.symbol_name = "workingset_refault";
+    refault_kp.pre_handler = refault_pre;
+    ret = register_kprobe(&refault_kp);
+    if (ret < 0)
+        pr_warn("register_kprobe workingset_refault failed (%d), no REFAULT records\n", ret);
+    refault_on = ret == 0;
+
+    pr_info("MGLRU monitor module loaded, %u pages per cpu ring.\n", ring_pages);
     return 0;
+
+err_debugfs:
+    debugfs_remove_recursive(debugfs_dir);
+err_free:
+    free_rings();
+    return ret;
 }
 
 static void __exit mglru_monitor_exit(void)
 {
+    if (refault_on)
+        unregister_kprobe(&refault_kp);
+    if (evict_on) {
+        unregister_kretprobe(&evict_krp);
+        unregister_kretprobe(&shrink_krp);
+    }
     unregister_kprobe(&kp);
+    debugfs_remove_recursive(debugfs_dir);
+    free_rings();
     pr_info("MGLRU monitor module unloaded.\n");
 }
 
@@ -111,4 +490,4 @@ module_exit(mglru_monitor_exit);
 
 MODULE_LICENSE("GPL");
 MODULE_AUTHOR("WuTa");
-MODULE_DESCRIPTION("Print folio addresses in MGLRU generations");
+MODULE_DESCRIPTION("Record MGLRU generation folios, evictions and refaults into per-cpu binary rings");